@@ -0,0 +1,66 @@
+/**
+   Throughput of the kernels of 'bulk::popcount' over buffers from 1 KiB to 1 GiB (by default).
+   A small buffer stays in the cache and is counted over and over, a big one is read from the memory.
+   Every kernel has to give the same count as the scalar loop, otherwise the benchmark fails.
+
+   Usage: benchmark [max megabytes=1024]
+*/
+
+#include <chrono>
+#include <cstdint>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "popcount.h"
+
+using namespace std;
+
+template <typename F>
+double measure(F f)
+{
+    const auto start = chrono::steady_clock::now();
+    f();
+    return chrono::duration<double>(chrono::steady_clock::now()-start).count();
+}
+
+int main(int argc, char *argv[])
+{
+    const size_t max_bytes = (argc>1? stoul(argv[1]) : 1024)<<20;
+    vector<uint64_t> buffer(max_bytes/sizeof(uint64_t));
+    mt19937_64 gen{1};
+    for(auto& v: buffer)
+        v = gen();
+
+    bulk::for_each_kernel([](const char* name, bulk::kernel k) {
+        if(k==bulk::best())
+            cout << "best kernel of this CPU: " << name << endl;
+    });
+    cout << setw(10) << "bytes";
+    bulk::for_each_kernel([](const char* name, bulk::kernel) { cout << setw(14) << name; });
+    cout << "   (GB/s)" << endl;
+    for(size_t bytes=1024; bytes<=max_bytes; bytes*=4) {
+        const bulk::words w{buffer.data(),bytes/sizeof(uint64_t)};
+        const size_t rounds = max<size_t>(1,(size_t{256}<<20)/bytes);   // 256 MiB at least
+        const auto expected = bulk::scalar(w);
+        cout << setw(10) << bytes;
+        bool same{true};
+        bulk::for_each_kernel([&](const char*, bulk::kernel kernel) {
+            const volatile bulk::kernel k = kernel;   // called every round, not hoisted out of the loop
+            size_t count{0};
+            const auto t = measure([&]{
+                for(size_t r=0; r<rounds; ++r)
+                    count += k(w);
+            });
+            same = same && count==expected*rounds;
+            cout << setw(14) << fixed << setprecision(2) << double(bytes)*rounds/(1<<30)/t;
+        });
+        cout << endl;
+        if(!same) {
+            cout << "the kernels disagree" << endl;
+            return 2;
+        }
+    }
+}
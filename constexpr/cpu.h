@@ -0,0 +1,67 @@
+#ifndef CONSTEXPR_CPU_H_
+#define CONSTEXPR_CPU_H_
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#define CPU_X86 1
+#define CPU_TARGET(features) __attribute__((target(features)))
+#include <immintrin.h>
+#elif defined(_M_X64) && defined(_MSC_VER)
+#define CPU_X86 1
+#define CPU_TARGET(features)
+#include <immintrin.h>
+#include <intrin.h>
+#endif
+
+/**
+   The instruction set extensions the SIMD kernels are picked by at run time, as CPUID tells on the first call.
+
+   A kernel is compiled for its own instruction set regardless of the compiler flags by 'CPU_TARGET("avx2")' & Co.
+   (MSVC needs no attribute), so it may be called only if the CPU has the extension and the OS saves its registers:
+   GCC and Clang check both by '__builtin_cpu_supports', with MSVC the XCR0 register is read by 'xgetbv'.
+
+   \see https://www.felixcloutier.com/x86/cpuid
+   \see https://www.felixcloutier.com/x86/xgetbv
+*/
+
+namespace cpu
+{
+
+struct extensions
+{
+    bool avx2{false};
+    bool avx512f{false};
+    bool avx512vpopcntdq{false};
+
+    extensions() noexcept
+    {
+#if defined(CPU_X86) && defined(_MSC_VER) && !defined(__clang__)
+        int r[4];
+        __cpuidex(r,0,0);
+        const int top = r[0];
+        __cpuidex(r,1,0);
+        const bool osxsave = r[2]&(1<<27);
+        const unsigned long long xcr0 = osxsave? _xgetbv(0) : 0;
+        if(top<7 || 6!=(xcr0&6))   // the OS saves the YMM state
+            return;
+        __cpuidex(r,7,0);
+        avx2 = r[1]&(1<<5);
+        avx512f = (r[1]&(1<<16)) && 0xE6==(xcr0&0xE6);   // and the ZMM state
+        avx512vpopcntdq = avx512f && (r[2]&(1<<14));
+#elif defined(CPU_X86)
+        __builtin_cpu_init();
+        avx2 = __builtin_cpu_supports("avx2");
+        avx512f = __builtin_cpu_supports("avx512f");
+        avx512vpopcntdq = avx512f && __builtin_cpu_supports("avx512vpopcntdq");
+#endif
+    }
+};
+
+inline const extensions& features() noexcept
+{
+    static const extensions e;
+    return e;
+}
+
+}   // end of namespace 'cpu'
+
+#endif // CONSTEXPR_CPU_H_
@@ -0,0 +1,78 @@
+/**
+   The binary GCD against the Euclidean one ('std::gcd', which 'recursion::gcd' and 'imperative::gcd' call) on random 64-bit numbers:
+      - pairs of numbers, as many as given
+      - a range of them with a common factor, so that nothing stops early: 'imperative::gcd' folds 'std::gcd' over it one by one,
+        'binary::gcd' tests whether the running GCD divides an element by a multiplication, then the same by all threads of the CPU
+   The results have to be the same, otherwise the benchmark fails.
+
+   Usage: benchmark [millions of pairs=10]
+*/
+
+#include <chrono>
+#include <cstdint>
+#include <iostream>
+#include <numeric>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "binary.h"
+
+using namespace std;
+
+template <typename F>
+double measure(F f)
+{
+   const auto start = chrono::steady_clock::now();
+   f();
+   return chrono::duration<double>(chrono::steady_clock::now()-start).count();
+}
+
+int main(int argc, char *argv[])
+{
+   const size_t count = (argc>1? stoul(argv[1]) : 10)*1'000'000;
+   mt19937_64 gen{1};
+   vector<uint64_t> a(count), b(count);
+   for(size_t i=0; i<count; ++i)
+      a[i] = gen(), b[i] = gen();
+
+   uint64_t euclid{0}, stein{0};
+   const auto te = measure([&]{
+      for(size_t i=0; i<count; ++i)
+         euclid += std::gcd(a[i],b[i]);
+   });
+   const auto ts = measure([&]{
+      for(size_t i=0; i<count; ++i)
+         stein += binary::gcd(a[i],b[i]);
+   });
+   if(euclid!=stein) {
+      cout << "the pairs disagree" << endl;
+      return 2;
+   }
+   cout << count << " pairs" << endl;
+   cout << "std::gcd:    " << te/count*1e9 << " ns" << endl;
+   cout << "binary::gcd: " << ts/count*1e9 << " ns (" << te/ts << "x)" << endl;
+
+   // 'a' times a common factor of 20 bits, 44 bits are left random
+   const uint64_t common = 2*(gen()%(1<<19))+1;
+   for(auto& v: a)
+      v = (v>>20)*common;
+   const span<const uint64_t> range{a};
+   uint64_t folded{0}, running{0}, parallel{0};
+   const auto tf = measure([&]{
+      for(const auto v: a)
+         folded = std::gcd(folded,v);
+   });
+   const auto tp = measure([&]{ running = binary::gcd(range); });
+   const size_t jobs = max(1u,thread::hardware_concurrency());
+   const auto tt = measure([&]{ parallel = binary::gcd(range,jobs); });
+   if(folded!=running || folded!=parallel || 0!=folded%common) {
+      cout << "the ranges disagree" << endl;
+      return 2;
+   }
+   cout << "range of " << count << ", gcd " << folded << endl;
+   cout << "std::gcd fold:          " << tf/count*1e9 << " ns per element" << endl;
+   cout << "binary::gcd:            " << tp/count*1e9 << " ns per element (" << tf/tp << "x)" << endl;
+   cout << "binary::gcd, " << jobs << " thread(s): " << tt/count*1e9 << " ns per element (" << tf/tt << "x)" << endl;
+}
@@ -0,0 +1,199 @@
+#ifndef CONSTEXPR_GCD_BINARY_H_
+#define CONSTEXPR_GCD_BINARY_H_
+
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <concepts>
+#include <cstddef>
+#include <limits>
+#include <ranges>
+#include <span>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+/**
+   Binary greatest common divisor (Stein's algorithm), without a single division.
+   Solution:
+      gcd(2a,2b) = 2*gcd(a,b), gcd(2a,b) = gcd(a,b) for an odd b, gcd(a,b) = gcd(|a-b|,min(a,b)) for both odd.
+   The factors of 2 are counted by 'std::countr_zero' (one 'tzcnt' or 'bsf') and shifted out at once, not one by one.
+   The trailing zeros of b-a are those of |a-b| as well, so they are counted while the minimum and the difference are being selected.
+
+   A range is reduced by a running GCD, which mostly divides the next element: whether it does is tested by a multiplication
+   with its inverse modulo 2^N, the GCD is computed only if it doesn't. That happens a few times at most, every time the GCD halves at least.
+   The reduction stops as soon as the result is 1, nothing can change it then.
+   A large range is split among threads, which stop each other at 1, their results are reduced by pairs.
+
+   \see https://en.wikipedia.org/wiki/Binary_GCD_algorithm
+   \see https://lemire.me/blog/2013/12/26/fastest-way-to-compute-the-greatest-common-divisor/
+   \see https://gmplib.org/~tege/divcnst-pldi94.pdf "Division by Invariant Integers using Multiplication", 9. Exact division by Granlund, Montgomery
+*/
+
+namespace binary
+{
+
+namespace private_
+{
+
+template <std::unsigned_integral T>
+constexpr T stein(T a, T b) noexcept
+{
+   if(0==a)
+      return b;
+   if(0==b)
+      return a;
+   const int shift = std::countr_zero(static_cast<T>(a|b));
+   a >>= std::countr_zero(a);
+   int zeros = std::countr_zero(b);
+   for(;;) {   // 'a' is odd
+      b >>= zeros;
+      const auto d = static_cast<T>(b-a);
+      zeros = std::countr_zero(d);
+      if(0==d)
+         return static_cast<T>(a<<shift);
+      const bool less = b<a;
+      const T low = less? b : a;
+      b = less? static_cast<T>(a-b) : d;
+      a = low;
+   }
+}
+
+template <std::integral T>
+constexpr std::make_unsigned_t<T> magnitude(T v) noexcept
+{
+   using U = std::make_unsigned_t<T>;
+   if constexpr(std::is_signed_v<T>)
+      return v<0? static_cast<U>(U{0}-static_cast<U>(v)) : static_cast<U>(v);
+   else
+      return v;
+}
+
+/**
+   'x' is a multiple of d = odd*2^shift if it has 'shift' trailing zeros at least and 'odd' divides x/2^shift:
+   the product of a multiple of 'odd' and its inverse is the exact quotient, not greater than max/odd; any other is greater.
+   The products are computed in 'W', at least 'unsigned': a type narrower than 'int' would be promoted to 'int' and overflow.
+*/
+template <std::unsigned_integral T>
+class divisor
+{
+   using W = std::common_type_t<T,unsigned>;
+
+public:
+   constexpr explicit divisor(T d) noexcept   // d != 0
+      : shift_{std::countr_zero(d)}
+   {
+      const auto odd = static_cast<T>(d>>shift_);
+      T x = odd;   // the inverse modulo 8, every step of Newton's doubles the correct bits
+      for(int bits=3; bits<std::numeric_limits<T>::digits; bits*=2)
+         x = static_cast<T>(W{x}*static_cast<T>(W{2}-W{odd}*W{x}));
+      inverse_ = x;
+      limit_ = static_cast<T>(std::numeric_limits<T>::max()/odd);   // once per divisor, not per element
+   }
+
+   constexpr bool divides(T x) const noexcept
+   {
+      return std::countr_zero(x)>=shift_ && static_cast<T>(W{static_cast<T>(x>>shift_)}*W{inverse_})<=limit_;
+   }
+
+private:
+   int shift_;
+   T   inverse_;
+   T   limit_;
+};
+
+}  // end of namespace private_
+
+/**
+   \retval the same as 'std::gcd(m,n)'
+*/
+template <std::integral T, std::integral U>
+constexpr std::common_type_t<T,U> gcd(T m, U n) noexcept
+{
+   using C = std::common_type_t<T,U>;
+   using M = std::make_unsigned_t<C>;
+   return static_cast<C>(private_::stein<M>(private_::magnitude<C>(m),private_::magnitude<C>(n)));
+}
+
+template <std::integral T, std::integral... U>
+constexpr auto gcd(T m, U... ns) noexcept requires (sizeof...(U)>1)
+{
+   return gcd(m,gcd(ns...));
+}
+
+/**
+   \retval the GCD of all elements, 0 of none
+*/
+template <std::integral T, std::size_t N>
+constexpr std::remove_cv_t<T> gcd(std::span<T,N> s) noexcept
+{
+   using V = std::remove_cv_t<T>;
+   using M = std::make_unsigned_t<V>;
+   std::size_t i{0};
+   M g{0};
+   while(i<s.size() && 0==g)
+      g = private_::magnitude(s[i++]);
+   if(0==g)
+      return 0;
+   private_::divisor<M> d{g};
+   for(; i<s.size() && 1!=g; ++i) {
+      const auto v = private_::magnitude(s[i]);
+      if(!d.divides(v)) {
+         g = private_::stein(g,v);
+         d = private_::divisor<M>{g};
+      }
+   }
+   return static_cast<V>(g);
+}
+
+template <std::ranges::contiguous_range R>
+constexpr auto gcd(const R& r) noexcept requires std::integral<std::ranges::range_value_t<R>>
+{
+   return gcd(std::span{std::ranges::data(r),std::ranges::size(r)});
+}
+
+constexpr std::size_t parallel_threshold{1<<16};   // elements, fewer are not worth a thread
+
+/**
+   The same as 'gcd(s)' by 'jobs' threads, each reduces a part of 's', the results are reduced by pairs.
+*/
+template <std::integral T>
+T gcd(std::span<const T> s, std::size_t jobs)
+{
+   jobs = std::min(std::max<std::size_t>(jobs,1),std::max<std::size_t>(s.size()/parallel_threshold,1));
+   if(1==jobs)
+      return gcd(s);
+
+   constexpr std::size_t step{4096};   // elements between looks at the others
+   std::atomic<bool> one{false};
+   std::vector<T> results(jobs);
+   const auto work = [&](std::size_t k) {
+      auto part = s.subspan(s.size()/jobs*k,k+1<jobs? s.size()/jobs : s.size()-s.size()/jobs*k);
+      T g{0};
+      for(; !part.empty() && !one.load(std::memory_order_relaxed); part = part.subspan(std::min(step,part.size()))) {
+         g = gcd(g,gcd(part.first(std::min(step,part.size()))));
+         if(1==g)
+            one = true;
+      }
+      results[k] = g;
+   };
+   std::vector<std::thread> threads;
+   for(std::size_t k=1; k<jobs; ++k)
+      threads.emplace_back(work,k);
+   work(0);
+   for(auto& t: threads)
+      t.join();
+   if(one)
+      return 1;
+   for(std::size_t n=jobs; n>1; n=(n+1)/2) {
+      for(std::size_t k=0; k<n/2; ++k)
+         results[k] = gcd(results[2*k],results[2*k+1]);
+      if(n%2)
+         results[n/2] = results[n-1];
+   }
+   return results[0];
+}
+
+}  // end of namespace binary
+
+#endif // CONSTEXPR_GCD_BINARY_H_
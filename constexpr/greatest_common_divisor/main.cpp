@@ -4,6 +4,8 @@
    The GCD of three or more numbers equals the product of the prime factors common to all the numbers,
    but it can also be calculated by repeatedly taking the GCDs of pairs of numbers.
 
+   The binary GCD (Stein's algorithm) of 'binary.h' does without division, at compile time and at run time.
+
    \see https://math.stackexchange.com/questions/1672249/greatest-common-divisor-of-more-than-two-numbers
    \see https://github.com/nikolaAV/Modern-Cpp/tree/master/constexpr/greatest_common_divisor
 */
@@ -12,6 +14,12 @@
 #include <cstddef>
 #include <utility>
 #include <array>
+#include <cassert>
+#include <cstdint>
+#include <random>
+#include <vector>
+
+#include "binary.h"
 
 namespace recursion
 {
@@ -97,8 +105,86 @@ void test2()
   }
 }
 
+void test3()
+{
+  using binary::gcd;
+
+  static_assert(8==gcd(48,16,24,96));
+  static_assert(1==gcd(1,2,3));
+  static_assert(2==gcd(8,6,4,2,10,12,100));
+  static_assert(6==gcd(-12,18));
+  static_assert(5==gcd(0,-5) && 0==gcd(0,0));
+  static_assert(std::uint64_t{1}<<63==gcd(std::uint64_t{1}<<63,std::uint64_t{0}));
+  static_assert(3==gcd(std::uint64_t{3}<<40,std::uint64_t{9}));
+
+  {   constexpr long arr[] = {48,16,24,96};
+      static_assert(8==gcd(arr));
+  }
+  {   constexpr std::array<unsigned short,3> arr{1,2,3};
+      static_assert(1==gcd(arr));
+  }
+  {   constexpr int arr[] = {8,6,4,2,10,12,100};
+      static_assert(2==gcd(arr));
+      static_assert(2==gcd(std::span{arr}.first(5)) && 0==gcd(std::span{arr}.first(0)));
+  }
+  {   constexpr auto arr = []{   // 16-bit, promoted to 'int' their products would overflow
+         std::array<std::uint16_t,4096> a{};
+         for(std::size_t i=0; i<a.size(); ++i)
+            a[i] = static_cast<std::uint16_t>(65535-i%3*4369);   // 65535, 61166, 56797: multiples of 4369
+         return a;
+      }();
+      static_assert(4369==gcd(arr));
+      constexpr std::uint16_t same[] = {65535,65535};
+      static_assert(65535==gcd(same));
+      constexpr short negative[] = {-32768,16384,-8192};
+      static_assert(8192==gcd(negative));
+  }
+  {   constexpr int arr[] = {0,-720,360,600,0,150,1<<30,77};   // the GCD goes 720, 360, 120, 30, 2, 1
+      static_assert(1==gcd(arr) && 2==gcd(std::span{arr}.first(7)) && 30==gcd(std::span{arr}.first(6)));
+  }
+
+  {   // divisibility without division
+      using binary::private_::divisor;
+      static_assert(divisor<unsigned>{48}.divides(96) && !divisor<unsigned>{48}.divides(72) && divisor<unsigned>{7}.divides(0));
+      static_assert(divisor<std::uint16_t>{65535}.divides(65535) && !divisor<std::uint16_t>{65533}.divides(65535));
+      for(unsigned d=1; d<600; ++d)
+         for(unsigned x=0; x<=0xFFFF; ++x)
+            assert(divisor<std::uint16_t>{static_cast<std::uint16_t>(d)}.divides(static_cast<std::uint16_t>(x))==(0==x%d));
+  }
+
+  std::mt19937_64 gen{1};
+  for(int i=0; i<100000; ++i) {
+      const auto a = gen()>>(gen()%64), b = gen()>>(gen()%64), k = gen()%1000+1;
+      if(a) {
+         const binary::private_::divisor<std::uint64_t> d{a};
+         assert(d.divides(b*k)==(0==b*k%a));
+         assert(a>UINT64_MAX/k || d.divides(a*k));
+      }
+      assert(std::gcd(a,b)==gcd(a,b));
+      assert(std::gcd(a*k,b*k)==gcd(a*k,b*k));
+      const auto x = static_cast<std::int32_t>(a), y = static_cast<std::int32_t>(b);
+      assert(std::gcd(x,y)==gcd(x,y));
+  }
+  for(std::size_t n: {0,1,2,5,8,1000,1<<17,(1<<18)+3}) {
+      const std::uint64_t common = gen()%(1<<20)+1;
+      std::vector<std::uint64_t> v(n);
+      for(auto& e: v)
+         e = (gen()>>24)*common;
+      const std::span<const std::uint64_t> s{v};
+      const auto expected = imperative::accumulate(v,[](auto x, auto y){ return std::gcd(x,y); },std::uint64_t{0});
+      assert(expected==gcd(s));
+      for(std::size_t jobs: {1,2,3,8})
+         assert(expected==gcd(s,jobs));
+      if(n>2) {
+         v[n/2] = 7919, v[n-1] = 7907;   // coprime primes, early exit
+         assert(1==gcd(std::span<const std::uint64_t>{v}) && 1==gcd(std::span<const std::uint64_t>{v},4));
+      }
+  }
+}
+
 int main()
 {
    test1();
    test2();
+   test3();
 }
@@ -0,0 +1,216 @@
+#ifndef CONSTEXPR_ISBN_BATCH_H_
+#define CONSTEXPR_ISBN_BATCH_H_
+
+#include <algorithm>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <vector>
+
+#include "../cpu.h"
+
+/**
+   Validation of many ISBNs at once: a contiguous buffer of fixed-width records in, a bitmap of the valid ones out.
+
+   A record is 'width' bytes, the ISBN is at its beginning (a newline, spaces or anything else may pad it up to the width).
+   The run-time kernel takes two records into one AVX2 register, a 128-bit lane each, and computes both checksums at once:
+      - '0' is subtracted from every byte, an 'X' in the last position of an ISBN-10 becomes 10
+      - every byte of the ISBN must be a digit, i.e. at most 9 as an unsigned byte after the subtraction ('X' at the end only)
+      - the digits are multiplied by the weights and added pairwise ('vpmaddubsw'), then horizontally ('vpmaddwd', 'vphaddd'):
+        10..1 and modulo 11 for ISBN-10, 1,3,1,3... and modulo 10 for ISBN-13 (EAN-13)
+   The padding has the weight 0 and doesn't count. Records too close to the end of the buffer to load 16 bytes,
+   and CPUs without AVX2, go through the scalar kernel.
+   Mixed input is routed by the length of the ISBN, the run of digits (and 'X') at the beginning of the record:
+   both checksums are computed for every record and the length selects one of them, there is no branch per record.
+
+   \see https://en.wikipedia.org/wiki/International_Standard_Book_Number#Check_digits
+*/
+
+namespace batch
+{
+
+using bitmap = std::vector<std::uint64_t>;
+
+inline bool test(const bitmap& b, std::size_t i) noexcept
+{
+   return b[i/64]>>(i%64)&1;
+}
+
+enum class format { isbn10, isbn13, any };   // 'any' of both, by length
+
+namespace scalar
+{
+
+inline bool isbn10(const char* s) noexcept
+{
+   std::uint32_t sum{0};
+   for(std::uint32_t i=0; i<10; ++i) {
+      std::uint32_t d = static_cast<unsigned char>(s[i])-'0';
+      if(9==i && 'X'==s[i])
+         d = 10;
+      else if(d>9)   // ':' is '0'+10, only 'X' is 10
+         return false;
+      sum += (10-i)*d;
+   }
+   return 0==sum%11;
+}
+
+inline bool isbn13(const char* s) noexcept
+{
+   std::uint32_t sum{0};
+   for(std::uint32_t i=0; i<13; ++i) {
+      const std::uint32_t d = static_cast<unsigned char>(s[i])-'0';
+      if(d>9)
+         return false;
+      sum += (i%2? 3 : 1)*d;
+   }
+   return 0==sum%10;
+}
+
+/**
+   \retval the length of the run of digits and 'X' at the beginning of the record
+*/
+inline std::size_t length(const char* s, std::size_t width) noexcept
+{
+   std::size_t n{0};
+   while(n<width && (static_cast<unsigned char>(s[n]-'0')<=9 || 'X'==s[n]))
+      ++n;
+   return n;
+}
+
+template <format F>
+inline bool valid(const char* s, std::size_t width) noexcept
+{
+   if constexpr(format::isbn10==F)
+      return isbn10(s);
+   else if constexpr(format::isbn13==F)
+      return isbn13(s);
+   else {
+      const auto n = length(s,width);
+      return (10==n && isbn10(s)) || (13==n && isbn13(s));
+   }
+}
+
+template <format F>
+inline void validate(const char* p, std::size_t width, std::size_t first, std::size_t last, std::uint64_t* bits) noexcept
+{
+   for(auto i=first; i<last; ++i)
+      bits[i/64] |= std::uint64_t{valid<F>(p+i*width,width)}<<(i%64);
+}
+
+inline void isbn10(const char* p, std::size_t width, std::size_t first, std::size_t last, std::uint64_t* bits) noexcept
+{
+   validate<format::isbn10>(p,width,first,last,bits);
+}
+
+}  // end of namespace scalar
+
+#ifdef CPU_X86
+
+namespace avx2
+{
+
+/**
+   Records [first,last) of which 'first' is even and every one has 16 bytes to load.
+*/
+template <format F>
+CPU_TARGET("avx2") inline void validate(const char* p, std::size_t width, std::size_t first, std::size_t last, std::uint64_t* bits) noexcept
+{
+   const __m256i zero = _mm256_set1_epi8('0');
+   const __m256i nine = _mm256_set1_epi8(9);
+   const __m256i ten = _mm256_set1_epi8(10);
+   const __m256i x = _mm256_set1_epi8('X');
+   const __m256i check = _mm256_setr_epi8(0,0,0,0,0,0,0,0,0,-1,0,0,0,0,0,0, 0,0,0,0,0,0,0,0,0,-1,0,0,0,0,0,0);
+   const __m256i weights10 = _mm256_setr_epi8(10,9,8,7,6,5,4,3,2,1,0,0,0,0,0,0, 10,9,8,7,6,5,4,3,2,1,0,0,0,0,0,0);
+   const __m256i weights13 = _mm256_setr_epi8(1,3,1,3,1,3,1,3,1,3,1,3,1,0,0,0, 1,3,1,3,1,3,1,3,1,3,1,3,1,0,0,0);
+   const __m256i ones = _mm256_set1_epi16(1);
+   const std::uint32_t within = width>=16? 0xFFFF : (1u<<width)-1;   // the bytes of a lane in its record
+
+   for(auto i=first; i+1<last; i+=2) {
+      const char* r = p+i*width;
+      const __m256i v = _mm256_loadu2_m128i(reinterpret_cast<const __m128i*>(r+width),reinterpret_cast<const __m128i*>(r));
+      const __m256i d = _mm256_sub_epi8(v,zero);
+      const __m256i is_x = _mm256_cmpeq_epi8(v,x);
+      const __m256i check_x = _mm256_and_si256(is_x,check);
+      const auto digits = static_cast<std::uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(_mm256_max_epu8(d,nine),nine)));
+      const auto xs = static_cast<std::uint32_t>(_mm256_movemask_epi8(check_x));
+      const __m256i pairs10 = _mm256_madd_epi16(_mm256_maddubs_epi16(_mm256_blendv_epi8(d,ten,check_x),weights10),ones);
+      const __m256i pairs13 = _mm256_madd_epi16(_mm256_maddubs_epi16(d,weights13),ones);
+      const __m256i h = _mm256_hadd_epi32(pairs10,pairs13);
+      const __m256i sums = _mm256_hadd_epi32(h,h);   // sum10, sum13 in every lane
+
+      const auto any_x = static_cast<std::uint32_t>(_mm256_movemask_epi8(is_x));
+      const auto lane = [&](unsigned k, std::uint32_t sum10, std::uint32_t sum13) -> std::uint64_t {
+         const std::uint32_t digit = digits>>(16*k)&0xFFFF;
+         const bool ok10 = (0x3FF==((digit|xs>>(16*k))&0x3FF)) & (0==sum10%11);
+         const bool ok13 = (0x1FFF==(digit&0x1FFF)) & (0==sum13%10);
+         if constexpr(format::isbn10==F)
+            return ok10;
+         else if constexpr(format::isbn13==F)
+            return ok13;
+         else {
+            const auto n = std::countr_one((digit|any_x>>(16*k))&within);
+            return ((10==n) & ok10) | ((13==n) & ok13);
+         }
+      };
+      const std::uint64_t valid = lane(0,_mm256_extract_epi32(sums,0),_mm256_extract_epi32(sums,1))
+                               | lane(1,_mm256_extract_epi32(sums,4),_mm256_extract_epi32(sums,5))<<1;
+      bits[i/64] |= valid<<(i%64);
+   }
+}
+
+}  // end of namespace avx2
+
+#endif // CPU_X86
+
+/**
+   \retval bit 'i' is set if record 'i' is valid, see 'format'
+*/
+template <format F>
+inline bitmap validate(std::span<const char> records, std::size_t width)
+{
+   const std::size_t count = width? records.size()/width : 0;
+   bitmap bits((count+63)/64,0);
+   if(width<(format::isbn13==F? 13 : 10))
+      return bits;
+   std::size_t done{0};
+#ifdef CPU_X86
+   if(cpu::features().avx2 && records.size()>=16) {
+      // records which have 16 bytes to load, an even number of them
+      const std::size_t loadable = std::min(count,(records.size()-16)/width+1)&~std::size_t{1};
+      avx2::validate<F>(records.data(),width,0,loadable,bits.data());
+      done = loadable;
+   }
+#endif
+   scalar::validate<F>(records.data(),width,done,count,bits.data());
+   return bits;
+}
+
+/**
+   \retval bit 'i' is set if record 'i' starts with a valid ISBN-10
+*/
+inline bitmap isbn10(std::span<const char> records, std::size_t width)
+{
+   return validate<format::isbn10>(records,width);
+}
+
+/**
+   \retval bit 'i' is set if record 'i' starts with a valid ISBN-13 (EAN-13)
+*/
+inline bitmap isbn13(std::span<const char> records, std::size_t width)
+{
+   return validate<format::isbn13>(records,width);
+}
+
+/**
+   \retval bit 'i' is set if record 'i' is a valid ISBN-10 or ISBN-13 as long as the run of digits it begins with
+*/
+inline bitmap isbn(std::span<const char> records, std::size_t width)
+{
+   return validate<format::any>(records,width);
+}
+
+}  // end of namespace batch
+
+#endif // CONSTEXPR_ISBN_BATCH_H_
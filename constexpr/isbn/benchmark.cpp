@@ -0,0 +1,137 @@
+/**
+   Throughput of the batch validation of ISBN-10: the scalar kernel against the AVX2 kernel, on records of 11 bytes
+   (an ISBN and a newline), three of four of them valid.
+   Then of mixed input: records of 14 bytes, half of them ISBN-10 (padded with spaces), half ISBN-13, routed by length.
+   Then of the lines of a file (in memory here), hyphenated as printed, by 1 thread and by all of them,
+   against a mere count of the lines, which is about what the memory delivers.
+
+   Usage: benchmark [millions of records=20]
+*/
+
+#include <bit>
+#include <chrono>
+#include <cstdint>
+#include <iostream>
+#include <random>
+#include <cstring>
+#include <string>
+#include <thread>
+
+#include "batch.h"
+#include "lines.h"
+
+using namespace std;
+
+template <typename F>
+double measure(F f)
+{
+   const auto start = chrono::steady_clock::now();
+   f();
+   return chrono::duration<double>(chrono::steady_clock::now()-start).count();
+}
+
+int main(int argc, char *argv[])
+{
+   const size_t count = (argc>1? stoul(argv[1]) : 20)*1'000'000;
+   constexpr size_t width{11};
+   string records;
+   records.reserve(count*width);
+   mt19937 gen{1};
+   for(size_t i=0; i<count; ++i) {
+      char code[width] = {0,0,0,0,0,0,0,0,0,0,'\n'};
+      size_t sum{0};
+      for(size_t k=0; k<9; ++k) {
+         code[k] = static_cast<char>('0'+gen()%10);
+         sum += (10-k)*(code[k]-'0');
+      }
+      const auto check = (11-sum%11)%11;
+      code[9] = 10==check? 'X' : static_cast<char>('0'+check);
+      if(0==i%4)
+         code[gen()%9] ^= 1;
+      records.append(code,width);
+   }
+
+   batch::bitmap scalar((count+63)/64,0), simd;
+   const auto ts = measure([&]{ batch::scalar::isbn10(records.data(),width,0,count,scalar.data()); });
+   const auto tb = measure([&]{ simd = batch::isbn10(records,width); });
+   if(scalar!=simd) {
+      cout << "the kernels disagree" << endl;
+      return 2;
+   }
+   size_t valid{0};
+   for(const auto b: simd)
+      valid += popcount(b);
+   const auto gb = double(records.size())/(1<<30);
+   cout << count << " records, " << valid << " valid" << endl;
+   cout << "scalar: " << count/ts/1e6 << " M/s, " << gb/ts << " GB/s" << endl;
+   cout << "batch:  " << count/tb/1e6 << " M/s, " << gb/tb << " GB/s (" << ts/tb << "x)" << endl;
+
+   // the same codes, every other one as ISBN-13
+   constexpr size_t wide{14};
+   string mixed;
+   mixed.reserve(count*wide);
+   for(size_t i=0; i<count; ++i) {
+      char code[wide] = {' ',' ',' ',' ',' ',' ',' ',' ',' ',' ',' ',' ',' ','\n'};
+      const char* r = records.data()+i*width;
+      if(i%2) {
+         code[0] = '9', code[1] = '7', code[2] = '8';
+         size_t sum{9+3*7+8};
+         for(size_t k=0; k<9; ++k) {
+            code[3+k] = r[k];
+            sum += ((3+k)%2? 3 : 1)*(r[k]-'0');
+         }
+         code[12] = static_cast<char>('0'+(10-sum%10)%10);
+         if(0==i%4)
+            code[3+gen()%9] ^= 1;
+      }
+      else
+         copy(r,r+10,code);
+      mixed.append(code,wide);
+   }
+   batch::bitmap scalar_mixed((count+63)/64,0), simd_mixed;
+   const auto tsm = measure([&]{ batch::scalar::validate<batch::format::any>(mixed.data(),wide,0,count,scalar_mixed.data()); });
+   const auto tbm = measure([&]{ simd_mixed = batch::isbn(mixed,wide); });
+   if(scalar_mixed!=simd_mixed) {
+      cout << "the kernels disagree on mixed input" << endl;
+      return 2;
+   }
+   valid = 0;
+   for(const auto b: simd_mixed)
+      valid += popcount(b);
+   const auto gbm = double(mixed.size())/(1<<30);
+   cout << count << " mixed records, " << valid << " valid" << endl;
+   cout << "scalar: " << count/tsm/1e6 << " M/s, " << gbm/tsm << " GB/s" << endl;
+   cout << "batch:  " << count/tbm/1e6 << " M/s, " << gbm/tbm << " GB/s (" << tsm/tbm << "x)" << endl;
+
+   // the same codes as text, "978-0-306-40615-7" or "0-306-40615-2"
+   string text;
+   text.reserve(count*18);
+   for(size_t i=0; i<count; ++i) {
+      const char* r = mixed.data()+i*wide;
+      if(i%2)
+         text.append(r,3).append(1,'-').append(r+3,1).append(1,'-').append(r+4,3).append(1,'-').append(r+7,5).append(1,'-').append(r+12,1);
+      else
+         text.append(r,1).append(1,'-').append(r+1,3).append(1,'-').append(r+4,5).append(1,'-').append(r+9,1);
+      text += '\n';
+   }
+   size_t newlines{0};
+   const auto tn = measure([&]{
+      for(const char* p = text.data(); (p = static_cast<const char*>(memchr(p,'\n',text.data()+text.size()-p))); ++p)
+         ++newlines;
+   });
+   const auto gbt = double(text.size())/(1<<30);
+   cout << newlines << " lines, " << gbt << " GB" << endl;
+   cout << "count of lines: " << gbt/tn << " GB/s" << endl;
+   const size_t all = max(1u,thread::hardware_concurrency());
+   for(const size_t jobs: {size_t{1},all}) {
+      size_t invalid{0};
+      const auto t = measure([&]{ lines::check(text,jobs,[&](uint64_t){ ++invalid; }); });
+      if(count-valid!=invalid) {
+         cout << "the lines disagree with the records" << endl;
+         return 2;
+      }
+      cout << "lines, " << jobs << " thread(s): " << count/t/1e6 << " M/s, " << gbt/t << " GB/s" << endl;
+      if(1==all)
+         break;
+   }
+}
\ No newline at end of file
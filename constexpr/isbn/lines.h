@@ -0,0 +1,343 @@
+#ifndef CONSTEXPR_ISBN_LINES_H_
+#define CONSTEXPR_ISBN_LINES_H_
+
+#include "batch.h"
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <exception>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <thread>
+#include <vector>
+
+#ifdef _WIN32
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+/**
+   Validation of a file of ISBNs, one per line, e.g. "978-0-306-40615-7".
+
+   The file is mapped read-only and split into as many parts as there are threads, each at the beginning of a line.
+   A thread turns the lines of its part into fixed-width records of 'batch.h':
+      - hyphens and spaces (and the '\r' of CRLF) are removed by a SIMD compaction, 32 bytes at a time: a mask of the bytes to keep,
+        a shuffle ('vpshufb') by indices of a table of 256 computed at compile time moves them together, 8 bytes per quarter;
+        the same loads find the newline, there is no separate search for the end of the line
+      - a line of anything else than digits, 'X', hyphens and spaces is invalid, so is one longer than a record
+   and the batch kernel validates a block of them at once. A line is valid if it is an ISBN-10 or an ISBN-13, and nothing else.
+   The numbers of the invalid lines are collected by every thread and reported in the order of the file.
+
+   \see https://lemire.me/blog/2017/01/20/how-quickly-can-you-remove-spaces-from-a-string/
+*/
+
+namespace lines
+{
+
+class mapped_file
+{
+public:
+   explicit mapped_file(const std::string& path)
+   {
+#ifdef _WIN32
+      file_ = ::CreateFileA(path.c_str(),GENERIC_READ,FILE_SHARE_READ,nullptr,OPEN_EXISTING,FILE_FLAG_SEQUENTIAL_SCAN,nullptr);
+      LARGE_INTEGER size;
+      if(INVALID_HANDLE_VALUE==file_ || !::GetFileSizeEx(file_,&size))
+         fail(path);
+      size_ = static_cast<std::size_t>(size.QuadPart);
+      if(0==size_)
+         return;
+      mapping_ = ::CreateFileMappingA(file_,nullptr,PAGE_READONLY,0,0,nullptr);
+      if(!mapping_ || !(data_ = static_cast<const char*>(::MapViewOfFile(mapping_,FILE_MAP_READ,0,0,0))))
+         fail(path);
+#else
+      fd_ = ::open(path.c_str(),O_RDONLY);
+      struct stat st;
+      if(fd_<0 || 0!=::fstat(fd_,&st))
+         fail(path);
+      size_ = st.st_size;
+      if(0==size_)
+         return;
+      void* p = ::mmap(nullptr,size_,PROT_READ,MAP_PRIVATE,fd_,0);
+      if(MAP_FAILED==p)
+         fail(path);
+      ::madvise(p,size_,MADV_SEQUENTIAL);
+      data_ = static_cast<const char*>(p);
+#endif
+   }
+
+   ~mapped_file() { close(); }
+
+   mapped_file(const mapped_file&) = delete;
+   mapped_file& operator=(const mapped_file&) = delete;
+
+   std::string_view view() const noexcept { return {data_,data_? size_ : 0}; }
+
+private:
+   [[noreturn]] void fail(const std::string& path)
+   {
+#ifdef _WIN32
+      const std::error_code e{static_cast<int>(::GetLastError()),std::system_category()};
+#else
+      const std::error_code e{errno,std::generic_category()};
+#endif
+      close();
+      throw std::system_error{e,path};
+   }
+
+   void close() noexcept
+   {
+#ifdef _WIN32
+      if(data_)
+         ::UnmapViewOfFile(data_);
+      if(mapping_)
+         ::CloseHandle(mapping_);
+      if(INVALID_HANDLE_VALUE!=file_)
+         ::CloseHandle(file_);
+#else
+      if(data_)
+         ::munmap(const_cast<char*>(data_),size_);
+      if(fd_>=0)
+         ::close(fd_);
+#endif
+   }
+
+#ifdef _WIN32
+   HANDLE      file_{INVALID_HANDLE_VALUE};
+   HANDLE      mapping_{nullptr};
+#else
+   int         fd_{-1};
+#endif
+   const char* data_{nullptr};
+   std::size_t size_{0};
+};
+
+constexpr std::size_t width{16};    // of a record, no ISBN with its padding is longer
+constexpr std::size_t block{4096};  // records validated at once
+
+namespace scalar
+{
+
+/**
+   Writes the line [p,p+n) without hyphens, spaces and '\r' to the record 'out', padded with spaces.
+*/
+inline void record(const char* p, std::size_t n, char* out) noexcept
+{
+   std::memset(out,' ',width);
+   std::size_t used{0};
+   bool bad{false};
+   for(std::size_t k=0; k<n && used<width; ++k) {
+      const char c = p[k];
+      if(static_cast<unsigned char>(c-'0')<=9 || 'X'==c)
+         out[used++] = c;
+      else
+         bad = bad || ('-'!=c && ' '!=c && '\r'!=c);
+   }
+   if(bad)
+      out[0] = '#';   // no ISBN starts with it
+}
+
+}  // end of namespace scalar
+
+#ifdef CPU_X86
+
+namespace private_
+{
+
+/**
+   \retval for every mask of 8 bits, the indices of its set bits first; 0x80 (a zero byte) for the rest
+*/
+constexpr std::array<std::array<std::uint8_t,8>,256> make_shuffles() noexcept
+{
+   std::array<std::array<std::uint8_t,8>,256> t{};
+   for(unsigned m=0; m<256; ++m) {
+      unsigned k{0};
+      for(unsigned b=0; b<8; ++b)
+         if(m>>b&1)
+            t[m][k++] = static_cast<std::uint8_t>(b);
+      for(; k<8; ++k)
+         t[m][k] = 0x80;
+   }
+   return t;
+}
+
+inline constexpr auto shuffles = make_shuffles();
+
+}  // end of namespace private_
+
+namespace avx2
+{
+
+/**
+   The same as 'scalar::record' of the line at 'p', which ends at its '\n' or at 'last'.
+   The line is read by 32 bytes, its newline is found by the same loads: 32 bytes before 'end' have to be readable, they may be past 'last'.
+   'out' gets more than 'width' written, 32 bytes after the record have to be writable (the next record overwrites them).
+   \retval the end of the line, nullptr if it isn't found within the readable bytes
+*/
+CPU_TARGET("avx2") inline const char* record(const char* p, const char* last, const char* end, char* out) noexcept
+{
+   const __m256i zero = _mm256_set1_epi8('0');
+   const __m256i nine = _mm256_set1_epi8(9);
+   const __m256i x = _mm256_set1_epi8('X');
+   const __m256i hyphen = _mm256_set1_epi8('-');
+   const __m256i space = _mm256_set1_epi8(' ');
+   const __m256i cr = _mm256_set1_epi8('\r');
+   const __m256i nl = _mm256_set1_epi8('\n');
+   const __m256i halves = _mm256_setr_epi64x(0,0x0808080808080808,0,0x0808080808080808);   // pshufb indices are within a lane of 16 bytes
+   const auto& table = private_::shuffles;
+
+   _mm_storeu_si128(reinterpret_cast<__m128i*>(out),_mm256_castsi256_si128(space));
+   std::size_t used{0};
+   std::uint32_t bad{0};
+   for(const char* q=p;; q+=32) {
+      if(end-q<32)
+         return nullptr;
+      const __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(q));
+      auto stop = static_cast<std::uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(v,nl)));
+      if(last-q<32)
+         stop |= 1u<<(last-q);
+      const std::uint32_t within = stop? (stop&(0u-stop))-1 : 0xFFFFFFFF;   // the bytes before the end of the line
+      if(used<width) {
+         const __m256i digit = _mm256_or_si256(_mm256_cmpeq_epi8(_mm256_max_epu8(_mm256_sub_epi8(v,zero),nine),nine),_mm256_cmpeq_epi8(v,x));
+         const __m256i skip = _mm256_or_si256(_mm256_or_si256(_mm256_cmpeq_epi8(v,hyphen),_mm256_cmpeq_epi8(v,space)),_mm256_cmpeq_epi8(v,cr));
+         const auto keep = static_cast<std::uint32_t>(_mm256_movemask_epi8(digit))&within;
+         bad |= within&~static_cast<std::uint32_t>(_mm256_movemask_epi8(_mm256_or_si256(digit,skip)));
+
+         std::uint64_t t[4];
+         std::memcpy(&t[0],table[keep&0xFF].data(),8);
+         std::memcpy(&t[1],table[keep>>8&0xFF].data(),8);
+         std::memcpy(&t[2],table[keep>>16&0xFF].data(),8);
+         std::memcpy(&t[3],table[keep>>24].data(),8);
+         const __m256i indices = _mm256_add_epi8(_mm256_setr_epi64x(t[0],t[1],t[2],t[3]),halves);
+         alignas(32) std::uint64_t packed[4];
+         _mm256_store_si256(reinterpret_cast<__m256i*>(packed),_mm256_shuffle_epi8(v,indices));
+         for(unsigned g=0; g<4; ++g) {
+            std::memcpy(out+used,&packed[g],8);
+            used += std::popcount(keep>>(8*g)&0xFF);
+         }
+      }
+      if(stop) {
+         if(used<width)   // the bytes after the ISBN are zeros of the shuffle or spaces, both end it
+            out[used] = ' ';
+         if(bad)
+            out[0] = '#';
+         return q+std::countr_zero(stop);
+      }
+   }
+}
+
+}  // end of namespace avx2
+
+#endif // CPU_X86
+
+/**
+   The invalid lines of a part of the file.
+*/
+struct part
+{
+   std::uint64_t              lines{0};
+   std::vector<std::uint64_t> invalid;   // numbers of the lines within the part, from 0
+};
+
+/**
+   \param 'text' starts at the beginning of a line, 'end' is the end of the readable memory after it
+*/
+inline part check(std::string_view text, const char* end)
+{
+   part r;
+   std::vector<char> records(block*width+32);
+   std::size_t count{0};
+   const auto flush = [&]{
+      const auto bits = batch::isbn({records.data(),count*width},width);
+      for(std::size_t w=0; w<bits.size(); ++w) {
+         const std::size_t n = std::min<std::size_t>(64,count-64*w);
+         auto invalid = ~bits[w]&(n<64? (std::uint64_t{1}<<n)-1 : ~std::uint64_t{0});
+         for(; invalid; invalid &= invalid-1)
+            r.invalid.push_back(r.lines-count+64*w+std::countr_zero(invalid));
+      }
+      count = 0;
+   };
+#ifdef CPU_X86
+   const bool simd = cpu::features().avx2;
+#endif
+   const char* const last = text.data()+text.size();
+   for(const char* p = text.data(); p<last;) {
+      char* out = records.data()+count*width;
+      const char* nl{nullptr};
+#ifdef CPU_X86
+      if(simd)
+         nl = avx2::record(p,last,end,out);
+#endif
+      if(!nl) {
+         nl = static_cast<const char*>(std::memchr(p,'\n',last-p));
+         if(!nl)
+            nl = last;
+         scalar::record(p,nl-p,out);
+      }
+      ++r.lines;
+      if(block==++count)
+         flush();
+      p = nl+1;
+   }
+   flush();
+   return r;
+}
+
+/**
+   Calls invalid(line) for every invalid line of 'text', numbered from 1, in order.
+   \retval the number of lines
+*/
+template <typename Invalid>
+std::uint64_t check(std::string_view text, std::size_t jobs, Invalid invalid)
+{
+   jobs = std::max<std::size_t>(jobs,1);
+   std::vector<const char*> bounds{text.data()};
+   for(std::size_t i=1; i<jobs; ++i) {
+      const char* b = std::max(bounds.back(),text.data()+text.size()/jobs*i);
+      const char* nl = static_cast<const char*>(std::memchr(b,'\n',text.data()+text.size()-b));
+      bounds.push_back(nl? nl+1 : text.data()+text.size());
+   }
+   bounds.push_back(text.data()+text.size());
+
+   std::vector<part> parts(jobs);
+   std::vector<std::exception_ptr> errors(jobs);
+   const auto work = [&](std::size_t i) {
+      try {
+         parts[i] = check({bounds[i],std::size_t(bounds[i+1]-bounds[i])},text.data()+text.size());
+      }
+      catch(...) {
+         errors[i] = std::current_exception();
+      }
+   };
+   std::vector<std::thread> threads;
+   for(std::size_t i=1; i<jobs; ++i)
+      threads.emplace_back(work,i);
+   work(0);
+   for(auto& t: threads)
+      t.join();
+   for(const auto& e: errors)
+      if(e)
+         std::rethrow_exception(e);
+
+   std::uint64_t first{1};
+   for(const auto& p: parts) {
+      for(const auto line: p.invalid)
+         invalid(first+line);
+      first += p.lines;
+   }
+   return first-1;
+}
+
+}  // end of namespace lines
+
+#endif // CONSTEXPR_ISBN_LINES_H_
@@ -1,5 +1,7 @@
 #include <cstddef>
 #include <cassert>
+#include <array>
+#include <stdexcept>
 #include <string_view>
 
 /**
@@ -8,6 +10,8 @@
    However, as an example, we are to validate the former format that used 10 digits.
    The last of the 10 digits is a checksum. 
    This digit is chosen so that the sum of all the ten digits, each multiplied by its (integer) weight, descending from 10 to 1, is a multiple of 11.
+   The 13-digit format is an EAN-13 (European Article Number) of the prefix 978 or 979: the weights alternate 1 and 3, the sum is a multiple of 10.
+   An ISBN-10 becomes an ISBN-13 with the prefix 978 and a new check digit, an ISBN-13 of the prefix 978 goes back the same way.
 
    And ... pay attention, 
    there is a possibility to do such validation for string literals at compile time. 
@@ -40,8 +44,16 @@ constexpr inline bool allowed(std::size_t d) noexcept {
    return d <= 10;
 }
 
+constexpr inline bool well_formed(const char* s) noexcept {
+   // 'X' (10) is the check digit only, an invalid character (11) must not vanish in the sum modulo 11
+   for(std::size_t i=0; i<9; ++i)
+      if(!allowed(digit(s[i])) || 10==digit(s[i]))
+         return false;
+   return allowed(digit(s[9]));
+}
+
 constexpr inline bool validate(const char* s, std::size_t size) noexcept {
-   if(10!=size)
+   if(10!=size || !well_formed(s))
       return false;
    return (   10*digit(s[0])
             +  9*digit(s[1])
@@ -84,6 +96,81 @@ namespace isbn10_literals
    }
 }  // end of namespace isbn10_literals
 
+namespace isbn13
+{
+
+constexpr inline bool validate(const char* s, std::size_t size) noexcept {
+   if(13!=size)
+      return false;
+   std::size_t sum{0};
+   for(std::size_t i=0; i<13; ++i) {
+      const auto d = isbn10::digit(s[i]);
+      if(d>9)
+         return false;
+      sum += (i%2? 3 : 1)*d;
+   }
+   return sum%10==0;
+}
+
+template <std::size_t N>
+constexpr inline bool validate(const char(&s)[N]) noexcept {
+   return validate(s,N-1);
+}
+
+constexpr inline bool validate(std::string_view s) noexcept {
+   return validate(s.data(),s.size());
+}
+
+}  // end of namespace isbn13
+
+namespace convert
+{
+   /**
+      The conversions throw on invalid input: a compile error in a constant expression, an exception at run time
+      \see https://github.com/nikolaAV/Modern-Cpp/tree/master/constexpr/invocation_context
+   */
+
+   constexpr inline std::array<char,13> to_isbn13(std::string_view s) {
+      if(!isbn10::validate(s))
+         throw std::invalid_argument{"no ISBN-10"};
+      std::array<char,13> r{'9','7','8'};
+      std::size_t sum{9+3*7+8};
+      for(std::size_t i=0; i<9; ++i) {
+         r[3+i] = s[i];
+         sum += ((3+i)%2? 3 : 1)*isbn10::digit(s[i]);
+      }
+      r[12] = static_cast<char>('0'+(10-sum%10)%10);
+      return r;
+   }
+
+   constexpr inline std::array<char,10> to_isbn10(std::string_view s) {
+      if(!isbn13::validate(s) || s.substr(0,3)!="978")
+         throw std::invalid_argument{"no ISBN-13 of the prefix 978"};
+      std::array<char,10> r{};
+      std::size_t sum{0};
+      for(std::size_t i=0; i<9; ++i) {
+         r[i] = s[3+i];
+         sum += (10-i)*isbn10::digit(s[3+i]);
+      }
+      const auto check = (11-sum%11)%11;
+      r[9] = 10==check? 'X' : static_cast<char>('0'+check);
+      return r;
+   }
+
+   template <std::size_t N>
+   constexpr inline std::string_view view(const std::array<char,N>& a) noexcept {
+      return {a.data(),N};
+   }
+}  // end of namespace convert
+
+namespace isbn13_literals
+{
+   constexpr inline std::string_view operator"" _isbn13(char const* s, std::size_t count) noexcept {
+       assert(isbn13::validate(s,count));   // the same as of '_isbn'
+       return std::string_view(s,count);
+   }
+}  // end of namespace isbn13_literals
+
 
 
 ///////// Example of usage:
@@ -91,19 +178,83 @@ namespace isbn10_literals
 
 #include <string>
 #include <numeric>
+#include <random>
+#include <vector>
+#include <charconv>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+
+#include "batch.h"
+#include "lines.h"
 
 
 void test01();
 void test02();
 void test03();
 void test04();
+void test05();
+void test06();
+void test07();
+void test08();
+int validate_file(const std::string& path, std::size_t jobs);
 
-int main()
+int main(int argc, char *argv[])
 {
+   if(argc>1) {   // isbn [--jobs N] <file of an ISBN per line>
+      std::string path;
+      std::size_t jobs = std::max(1u,std::thread::hardware_concurrency());
+      for(int i=1; i<argc; ++i) {
+         const std::string_view arg{argv[i]};
+         if("--jobs"==arg && i+1<argc)
+            jobs = std::strtoul(argv[++i],nullptr,10);
+         else if(path.empty() && arg.substr(0,2)!="--")
+            path = arg;
+         else
+            path.clear(), i = argc;
+      }
+      if(path.empty() || 0==jobs) {
+         std::cerr << "Usage: " << argv[0] << " [--jobs N] <file of an ISBN per line>" << std::endl
+                   << "       prints the numbers of the invalid lines, exits with 1 if there are any" << std::endl;
+         return 2;
+      }
+      return validate_file(path,jobs);
+   }
    test01();
    test02();
    test03();
    test04();
+   test05();
+   test06();
+   test07();
+   test08();
+}
+
+int validate_file(const std::string& path, std::size_t jobs)
+{
+   try {
+      const lines::mapped_file file{path};
+      std::string out;                 // written out by 64 KiB
+      out.reserve(64*1024+32);
+      std::uint64_t invalid{0};
+      lines::check(file.view(),jobs,[&](std::uint64_t line) {
+         char digits[24];
+         const auto end = std::to_chars(digits,digits+sizeof(digits),line).ptr;
+         out.append(digits,end);
+         out += '\n';
+         if(out.size()>=64*1024) {
+            std::fwrite(out.data(),1,out.size(),stdout);
+            out.clear();
+         }
+         ++invalid;
+      });
+      std::fwrite(out.data(),1,out.size(),stdout);
+      return invalid? 1 : 0;
+   }
+   catch(const std::exception& e) {
+      std::cerr << e.what() << std::endl;
+      return 2;
+   }
 }
 
 
@@ -220,3 +371,170 @@ void test04()
 //      ,"1843560284"_isbn   
    };
 }
+
+void test05()
+{
+   // batch validation of records of 11 bytes (an ISBN and a newline): the same as one by one, whatever the number of records
+   std::mt19937 gen{1};
+   std::string buffer;
+   for(int i=0; i<1000; ++i) {
+      std::string code(10,'0');
+      std::size_t sum{0};
+      for(std::size_t k=0; k<9; ++k) {
+         code[k] = static_cast<char>('0'+gen()%10);
+         sum += (10-k)*(code[k]-'0');
+      }
+      const auto check = (11-sum%11)%11;
+      code[9] = 10==check? 'X' : static_cast<char>('0'+check);
+      switch(gen()%4) {   // a quarter valid, the others broken in some way
+         case 0: break;
+         case 1: code[gen()%10] = "0123456789X -:/x"[gen()%16]; break;   // ':' and '/' are next to the digits
+         case 2: std::swap(code[gen()%10],code[gen()%10]); break;
+         case 3: code[gen()%9] = 'X'; break;
+      }
+      buffer += code + '\n';
+   }
+   for(std::size_t n: {0,1,2,3,64,65,999,1000}) {
+      const std::string_view records{buffer.data(),n*11};
+      const auto bits = batch::isbn10(records,11);
+      for(std::size_t i=0; i<n; ++i)
+         assert(batch::test(bits,i)==isbn10::validate(records.substr(i*11,10)));
+   }
+   static_assert(!isbn10::validate("X999999999"));   // 'X' is the check digit only
+   assert(!batch::test(batch::isbn10("X999999999\n",11),0));
+   static_assert(!isbn10::validate("080442957:"));   // its weighted sum with ':' as 10 is a multiple of 11
+   const auto colons = batch::isbn10("080442957:\n080442957:\n080442957:\n080442957:\n",11);
+   for(std::size_t i=0; i<4; ++i)
+      assert(!batch::test(colons,i));
+}
+
+void test06()
+{
+   using isbn13::validate;
+   using convert::to_isbn13;
+   using convert::to_isbn10;
+   using convert::view;
+
+   static_assert(validate("9780306406157"));
+   static_assert(validate("9783161484100"));
+   static_assert(validate("9791090636071"));
+   static_assert(validate("4006381333931"));   // any EAN-13
+   static_assert(!validate("9780306406158"));
+   static_assert(!validate("978030640615"));
+   static_assert(!validate("97803064061570"));
+   static_assert(!validate("978030640615X"));
+
+   static_assert(view(to_isbn13("0306406152"))=="9780306406157");
+   static_assert(view(to_isbn13("080442957X"))=="9780804429573");
+   static_assert(view(to_isbn10("9780306406157"))=="0306406152");
+   static_assert(view(to_isbn10("9780804429573"))=="080442957X");
+// static_assert(view(to_isbn10("9791090636071"))=="");   <-- Compile Error: no ISBN-10 of the prefix 979
+
+   for(const std::string_view s: {"9992158107","9971502100","9604250590","097522980X"}) {
+      assert(validate(view(to_isbn13(s))));
+      assert(view(to_isbn10(view(to_isbn13(s))))==s);
+   }
+   try {
+      to_isbn10(std::string{"9791090636071"});
+      assert(false);
+   }
+   catch(const std::invalid_argument&) {
+   }
+
+   using namespace isbn13_literals;
+   constexpr std::string_view codes[] = {
+       "9780306406157"_isbn13
+      ,"9783161484100"_isbn13
+//    ,"9780306406158"_isbn13   <-- Compile Error
+   };
+   static_assert(2==std::size(codes));
+}
+
+void test07()
+{
+   // records of 15 bytes, ISBN-10 and ISBN-13 mixed: routed by length, the same as one by one
+   std::mt19937 gen{2};
+   std::string buffer;
+   std::vector<bool> expected;
+   for(int i=0; i<1000; ++i) {
+      std::string code(9,'0');
+      for(auto& c: code)
+         c = static_cast<char>('0'+gen()%10);
+      std::size_t sum{0};
+      for(std::size_t k=0; k<9; ++k)
+         sum += (10-k)*(code[k]-'0');
+      const auto check = (11-sum%11)%11;
+      code += 10==check? 'X' : static_cast<char>('0'+check);
+      if(gen()%2)
+         code = std::string{convert::view(convert::to_isbn13(code))};
+      switch(gen()%5) {
+         case 0: break;
+         case 1: code[gen()%code.size()] = "0123456789X"[gen()%11]; break;
+         case 2: code.pop_back(); break;
+         case 3: code += '1'; break;
+         case 4: code[gen()%code.size()] = ' '; break;
+      }
+      const auto isbn = std::string_view{code}.substr(0,code.find_first_not_of("0123456789X"));   // the rest pads the record
+      expected.push_back(isbn10::validate(isbn) || isbn13::validate(isbn));
+      code.resize(15,' ');
+      code.back() = '\n';
+      buffer += code;
+   }
+   for(std::size_t n: {0,1,2,63,64,999,1000}) {
+      const std::string_view records{buffer.data(),n*15};
+      const auto bits = batch::isbn(records,15);
+      const auto bits13 = batch::isbn13(records,15);
+      for(std::size_t i=0; i<n; ++i) {
+         assert(batch::test(bits,i)==expected[i]);
+         assert(batch::test(bits13,i)==isbn13::validate(records.substr(i*15,13)));
+      }
+   }
+   // 13 bytes wide: the next record is not a part of the length
+   const std::string tight{"97803064061579780306406157"};
+   assert(0b11==batch::isbn(tight,13)[0]);
+}
+
+void test08()
+{
+   // lines of a file: hyphens and spaces don't count, anything else does; the SIMD compaction and the scalar one agree
+   const std::string text =
+      "978-0-306-40615-7\n"         // 1
+      "0-306-40615-2\r\n"          // 2  CRLF
+      "  0 306 40615 2  \n"        // 3
+      "\n"                          // 4  invalid: empty
+      "978-0-306-40615-8\n"         // 5  invalid: check digit
+      "0-306-40615-2x\n"            // 6  invalid: a letter
+      "978-0-306-40615-7-1234\n"    // 7  invalid: too long
+      "080442957X\n"                // 8
+      "0804429X57\n"                // 9  invalid: 'X' not at the end
+      "97803064061571234567890\n"   // 10 invalid: longer than a record
+      "9780306406157";              // 11 without a newline
+   const std::vector<std::uint64_t> expected{4,5,6,7,9,10};
+   for(std::size_t jobs: {1,2,3,16}) {
+      std::vector<std::uint64_t> invalid;
+      const auto count = lines::check(text,jobs,[&](std::uint64_t line){ invalid.push_back(line); });
+      assert(11==count);
+      assert(expected==invalid);
+   }
+
+   std::mt19937 gen{3};
+   const std::string_view alphabet{"0123456789X- -9\r#"};
+   for(int i=0; i<10000; ++i) {
+      std::string line(gen()%40,' ');
+      for(auto& c: line)
+         c = alphabet[gen()%alphabet.size()];
+      line.append(32,'\n');   // readable after the line
+      char simd[3*lines::width], scalar[lines::width];
+      const auto n = gen()%(line.size()-31);
+      lines::scalar::record(line.data(),n,scalar);
+#ifdef CPU_X86
+      if(cpu::features().avx2) {
+         assert(line.data()+n==lines::avx2::record(line.data(),line.data()+n,line.data()+line.size(),simd));
+         const std::string_view a{simd,lines::width}, b{scalar,lines::width};
+         const auto isbn = [](std::string_view r){ return r.substr(0,r.find_first_not_of("0123456789X")); };
+         assert(isbn(b).size()==lines::width || isbn(a)==isbn(b));   // a longer line is invalid anyway
+         assert(batch::scalar::valid<batch::format::any>(simd,lines::width)==batch::scalar::valid<batch::format::any>(scalar,lines::width));
+      }
+#endif
+   }
+}
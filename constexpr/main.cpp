@@ -1,8 +1,12 @@
 #include <string>
 #include <iostream>
 #include <array>
+#include <vector>
+#include <random>
 #include <cassert>
 
+#include "popcount.h"
+
 // Book [ISBN 978-5-93286-205-6] "The D Programming Language" (Andrei Alexandresku), page 120
 // http://en.wikipedia.org/wiki/Hamming_weight
 // http://bisqwit.iki.fi/source/misc/bitcounting/
@@ -86,6 +90,26 @@ int main(int /*argc*/, char** /*argv[]*/)
     assert(8==runtime::recursive::sparse(255));
 
     constexpr array<size_t,3> arr{compilertime::naive(10), compilertime::naive(0), compilertime::naive(255)};
+    static_assert(8==compilertime::sparse(255));
+
+    {   // bulk counting: every kernel agrees with the bit by bit count, at any length and alignment
+        mt19937_64 gen{1};
+        vector<uint64_t> buffer(1031);
+        for(auto& v: buffer)
+            v = gen()&gen();
+        size_t expected{0};
+        for(size_t n=0; n<=buffer.size(); ++n) {
+            bulk::for_each_kernel([&](const char*, bulk::kernel k) {
+                assert(expected==k({buffer.data(),n}));
+            });
+            if(n<buffer.size())
+                expected += runtime::sparse(buffer[n]);
+        }
+        assert(expected==bulk::popcount(buffer));
+        bulk::for_each_kernel([&](const char*, bulk::kernel k) {
+            assert(expected-runtime::sparse(buffer[0])==k(bulk::words{buffer}.subspan(1)));
+        });
+    }
 
     cout << arr[0] << arr[1] << arr[2] <<endl;
     cout << "Press any key + <enter> to exit" << endl;
@@ -0,0 +1,96 @@
+/**
+   Throughput of 'min' and 'minmax' of a span of 'int32_t' and of 'double', from 1 KiB to 1 GiB (by default):
+   'std::min_element' and 'std::minmax_element' against the scalar loop and the kernels of 'reduce', then threads for a large span.
+   A small span stays in the cache and is reduced over and over, a big one is read from the memory.
+   Every one has to give the same result, otherwise the benchmark fails.
+
+   Usage: benchmark [max megabytes=1024]
+*/
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "reduce.h"
+
+using namespace std;
+
+template <typename F>
+double measure(F f)
+{
+   const auto start = chrono::steady_clock::now();
+   f();
+   return chrono::duration<double>(chrono::steady_clock::now()-start).count();
+}
+
+template <typename T>
+bool run(const char* type, size_t max_bytes)
+{
+   vector<T> buffer(max_bytes/sizeof(T));
+   mt19937_64 gen{1};
+   for(auto& v: buffer)
+      v = static_cast<T>(static_cast<int64_t>(gen())>>16);
+
+   using reduce::op;
+   using kernel = pair<T,T>(*)(span<const T>);
+   vector<pair<string,kernel>> kernels{
+      {"min_element",[](span<const T> s) { return pair{*min_element(s.begin(),s.end()),T{}}; }},
+      {"minmax_element",[](span<const T> s) { const auto r = minmax_element(s.begin(),s.end()); return pair{*r.first,*r.second}; }},
+      {"scalar",reduce::scalar<op::minmax,T>}};
+#ifdef CPU_X86
+   if(cpu::features().avx2) {
+      kernels.emplace_back("avx2 min",[](span<const T> s) { return pair{reduce::avx2<op::min,T>(s).first,T{}}; });
+      kernels.emplace_back("avx2 minmax",reduce::avx2<op::minmax,T>);
+   }
+   if(cpu::features().avx512f) {
+      kernels.emplace_back("avx512 min",[](span<const T> s) { return pair{reduce::avx512<op::min,T>(s).first,T{}}; });
+      kernels.emplace_back("avx512 minmax",reduce::avx512<op::minmax,T>);
+   }
+#endif
+   const size_t jobs = max(1u,thread::hardware_concurrency());
+   kernels.emplace_back("threads",[](span<const T> s) {
+      static const size_t jobs = max(1u,thread::hardware_concurrency());
+      return reduce::apply<op::minmax,T>(s,jobs);
+   });
+
+   cout << type << ", " << jobs << " thread(s)" << endl << setw(12) << "bytes";
+   for(const auto& k: kernels)
+      cout << setw(16) << k.first;
+   cout << "   (GB/s)" << endl;
+   for(size_t bytes=1024; bytes<=max_bytes; bytes*=4) {
+      const span<const T> s{buffer.data(),bytes/sizeof(T)};
+      const size_t rounds = max<size_t>(1,(size_t{256}<<20)/bytes);   // 256 MiB at least
+      const auto expected = reduce::scalar<op::minmax,T>(s);
+      cout << setw(12) << bytes;
+      bool same{true};
+      for(const auto& [name,kernel]: kernels) {
+         const volatile auto k = kernel;   // called every round, not hoisted out of the loop
+         pair<T,T> r;
+         const auto t = measure([&]{
+            for(size_t i=0; i<rounds; ++i)
+               r = k(s);
+         });
+         same = same && r.first==expected.first && (T{}==r.second || r.second==expected.second);
+         cout << setw(16) << fixed << setprecision(2) << double(bytes)*rounds/(1<<30)/t;
+      }
+      cout << endl;
+      if(!same) {
+         cout << "the kernels disagree" << endl;
+         return false;
+      }
+   }
+   return true;
+}
+
+int main(int argc, char *argv[])
+{
+   const size_t max_bytes = (argc>1? stoul(argv[1]) : 1024)<<20;
+   if(!run<int32_t>("int32_t",max_bytes) || !run<double>("double",max_bytes))
+      return 2;
+}
@@ -1,9 +1,18 @@
 /**
    'min' & 'max' compile time math functions with any numbers of arguments   
+   and their run-time overloads for a span, 'minmax' of both at once
 */
 #include <algorithm>
 #include <cstddef>
 #include <utility>
+#include <span>
+#include <type_traits>
+#include <cassert>
+#include <cstdint>
+#include <random>
+#include <vector>
+
+#include "reduce.h"
 
 namespace private_
 {
@@ -55,6 +64,43 @@ constexpr auto max(const T(&arr)[N]) {
    return apply(bin_op::max,arr,std::make_index_sequence<N>{});
 }
 
+/**
+   Run-time overloads: SIMD lanes, threads for a large span
+   \see reduce.h
+*/
+template<typename T, std::size_t N > 
+auto min(std::span<T,N> s) {
+   return reduce::min<std::remove_cv_t<T>>(s);
+}
+
+template<typename T, std::size_t N > 
+auto max(std::span<T,N> s) {
+   return reduce::max<std::remove_cv_t<T>>(s);
+}
+
+template<typename T, std::size_t N > 
+auto minmax(std::span<T,N> s) {
+   return reduce::minmax<std::remove_cv_t<T>>(s);
+}
+
+template <typename T>
+void test_span(std::mt19937_64& gen)
+{
+   for(std::size_t n: {1,2,7,64,65,1000,(1<<22)+13}) {
+      std::vector<T> v(n);
+      for(auto& e: v)
+         e = static_cast<T>(gen()>>(gen()%64));
+      v[gen()%n] = std::numeric_limits<T>::lowest();   // at any position
+      const auto lo = *std::min_element(v.begin(),v.end());
+      const auto hi = *std::max_element(v.begin(),v.end());
+      const std::span s{v};
+      assert(lo==min(s) && hi==max(s));
+      assert(std::pair(lo,hi)==minmax(s));
+      assert(std::pair(lo,hi)==(reduce::apply<reduce::op::minmax,T>(s,5)));
+   }
+   assert(reduce::greatest<T>()==min(std::span<const T>{}) && reduce::lowest<T>()==max(std::span<const T>{}));
+}
+
 int main()
 {
    static_assert(0==min(0,1,2,3,4,5,6,7,8,9));
@@ -68,4 +114,13 @@ int main()
    static_assert(1==min(arr2));
    static_assert(9==max(arr1));
    static_assert(2==max(arr2));
+
+   std::mt19937_64 gen{1};
+   test_span<std::int32_t>(gen);
+   test_span<std::uint32_t>(gen);
+   test_span<std::int64_t>(gen);
+   test_span<std::uint64_t>(gen);
+   test_span<float>(gen);
+   test_span<double>(gen);
+   test_span<std::int16_t>(gen);   // the scalar loop
 }
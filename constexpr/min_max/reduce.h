@@ -0,0 +1,352 @@
+#ifndef CONSTEXPR_MIN_MAX_REDUCE_H_
+#define CONSTEXPR_MIN_MAX_REDUCE_H_
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <span>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "../cpu.h"
+
+/**
+   'min', 'max' and both of them in one pass ('minmax') of a span at run time, the counterpart of the compile time versions.
+
+   A vector register holds as many running minima (maxima) as it has lanes, 'vpminsd' & Co. update all of them at once,
+   four registers of them at a time so that the loads and the comparisons overlap. The lanes are reduced horizontally at the end.
+      avx2   : 256 bits, 64-bit integers compared by 'vpcmpgtq' and blended, AVX2 has no 'vpminsq'
+      avx512 : 512 bits (AVX-512F)
+   32- and 64-bit integers, 'float' and 'double' have SIMD kernels, other types go through the scalar loop; the best kernel
+   which the CPU supports is chosen by CPUID. A span of 'parallel_threshold' elements and more is split among threads.
+   The minimum of an empty span is the greatest value of the type (infinity of a floating point one), the maximum the lowest:
+   the identity of the reduction. The result of a span with a NaN in it is unspecified.
+
+   \see https://www.intel.com/content/www/us/en/docs/intrinsics-guide/index.html#text=_mm256_min_epi32
+*/
+
+namespace reduce
+{
+
+enum class op { min, max, minmax };
+
+template <typename T>
+constexpr T greatest() noexcept
+{
+   if constexpr(std::numeric_limits<T>::has_infinity)
+      return std::numeric_limits<T>::infinity();
+   else
+      return std::numeric_limits<T>::max();
+}
+
+template <typename T>
+constexpr T lowest() noexcept
+{
+   if constexpr(std::numeric_limits<T>::has_infinity)
+      return -std::numeric_limits<T>::infinity();
+   else
+      return std::numeric_limits<T>::lowest();
+}
+
+/**
+   \retval {min,max} of 's', only the one(s) of 'O', the other one is the identity
+*/
+template <op O, typename T>
+std::pair<T,T> scalar(std::span<const T> s) noexcept
+{
+   T lo = greatest<T>(), hi = lowest<T>();
+   for(const auto v: s) {
+      if constexpr(op::max!=O)
+         lo = std::min(lo,v);
+      if constexpr(op::min!=O)
+         hi = std::max(hi,v);
+   }
+   return {lo,hi};
+}
+
+#ifdef CPU_X86
+
+namespace private_
+{
+
+template <typename T>
+constexpr bool has_lanes = std::is_same_v<T,std::int32_t> || std::is_same_v<T,std::uint32_t>
+                        || std::is_same_v<T,std::int64_t> || std::is_same_v<T,std::uint64_t>
+                        || std::is_same_v<T,float> || std::is_same_v<T,double>;
+
+/**
+   A vector of lanes of T: its type 'vec', min and max of two vectors.
+*/
+template <typename T> struct avx2;
+template <typename T> struct avx512;
+
+#define REDUCE_AVX2 CPU_TARGET("avx2")
+#define REDUCE_AVX512 CPU_TARGET("avx512f")
+
+template <> struct avx2<std::int32_t>
+{
+   using vec = __m256i;
+   REDUCE_AVX2 static vec min(vec a, vec b) noexcept { return _mm256_min_epi32(a,b); }
+   REDUCE_AVX2 static vec max(vec a, vec b) noexcept { return _mm256_max_epi32(a,b); }
+};
+
+template <> struct avx2<std::uint32_t>
+{
+   using vec = __m256i;
+   REDUCE_AVX2 static vec min(vec a, vec b) noexcept { return _mm256_min_epu32(a,b); }
+   REDUCE_AVX2 static vec max(vec a, vec b) noexcept { return _mm256_max_epu32(a,b); }
+};
+
+template <> struct avx2<std::int64_t>
+{
+   using vec = __m256i;
+   REDUCE_AVX2 static vec min(vec a, vec b) noexcept { return _mm256_blendv_epi8(a,b,_mm256_cmpgt_epi64(a,b)); }
+   REDUCE_AVX2 static vec max(vec a, vec b) noexcept { return _mm256_blendv_epi8(b,a,_mm256_cmpgt_epi64(a,b)); }
+};
+
+template <> struct avx2<std::uint64_t>
+{
+   using vec = __m256i;
+   REDUCE_AVX2 static vec greater(vec a, vec b) noexcept   // unsigned as signed, the sign bit flipped
+   {
+      const __m256i sign = _mm256_set1_epi64x(INT64_MIN);
+      return _mm256_cmpgt_epi64(_mm256_xor_si256(a,sign),_mm256_xor_si256(b,sign));
+   }
+   REDUCE_AVX2 static vec min(vec a, vec b) noexcept { return _mm256_blendv_epi8(a,b,greater(a,b)); }
+   REDUCE_AVX2 static vec max(vec a, vec b) noexcept { return _mm256_blendv_epi8(b,a,greater(a,b)); }
+};
+
+template <> struct avx2<float>
+{
+   using vec = __m256;
+   REDUCE_AVX2 static vec min(vec a, vec b) noexcept { return _mm256_min_ps(a,b); }
+   REDUCE_AVX2 static vec max(vec a, vec b) noexcept { return _mm256_max_ps(a,b); }
+};
+
+template <> struct avx2<double>
+{
+   using vec = __m256d;
+   REDUCE_AVX2 static vec min(vec a, vec b) noexcept { return _mm256_min_pd(a,b); }
+   REDUCE_AVX2 static vec max(vec a, vec b) noexcept { return _mm256_max_pd(a,b); }
+};
+
+// the masked forms: GCC 12 warns that the unmasked ones use an uninitialized (undefined) source
+template <> struct avx512<std::int32_t>
+{
+   using vec = __m512i;
+   static constexpr __mmask16 all{0xFFFF};
+   REDUCE_AVX512 static vec min(vec a, vec b) noexcept { return _mm512_maskz_min_epi32(all,a,b); }
+   REDUCE_AVX512 static vec max(vec a, vec b) noexcept { return _mm512_maskz_max_epi32(all,a,b); }
+};
+
+template <> struct avx512<std::uint32_t>
+{
+   using vec = __m512i;
+   static constexpr __mmask16 all{0xFFFF};
+   REDUCE_AVX512 static vec min(vec a, vec b) noexcept { return _mm512_maskz_min_epu32(all,a,b); }
+   REDUCE_AVX512 static vec max(vec a, vec b) noexcept { return _mm512_maskz_max_epu32(all,a,b); }
+};
+
+template <> struct avx512<std::int64_t>
+{
+   using vec = __m512i;
+   static constexpr __mmask8 all{0xFF};
+   REDUCE_AVX512 static vec min(vec a, vec b) noexcept { return _mm512_maskz_min_epi64(all,a,b); }
+   REDUCE_AVX512 static vec max(vec a, vec b) noexcept { return _mm512_maskz_max_epi64(all,a,b); }
+};
+
+template <> struct avx512<std::uint64_t>
+{
+   using vec = __m512i;
+   static constexpr __mmask8 all{0xFF};
+   REDUCE_AVX512 static vec min(vec a, vec b) noexcept { return _mm512_maskz_min_epu64(all,a,b); }
+   REDUCE_AVX512 static vec max(vec a, vec b) noexcept { return _mm512_maskz_max_epu64(all,a,b); }
+};
+
+template <> struct avx512<float>
+{
+   using vec = __m512;
+   static constexpr __mmask16 all{0xFFFF};
+   REDUCE_AVX512 static vec min(vec a, vec b) noexcept { return _mm512_maskz_min_ps(all,a,b); }
+   REDUCE_AVX512 static vec max(vec a, vec b) noexcept { return _mm512_maskz_max_ps(all,a,b); }
+};
+
+template <> struct avx512<double>
+{
+   using vec = __m512d;
+   static constexpr __mmask8 all{0xFF};
+   REDUCE_AVX512 static vec min(vec a, vec b) noexcept { return _mm512_maskz_min_pd(all,a,b); }
+   REDUCE_AVX512 static vec max(vec a, vec b) noexcept { return _mm512_maskz_max_pd(all,a,b); }
+};
+
+/**
+   \retval 'r' reduced with the lanes of 'lo' and 'hi'
+*/
+template <op O, typename T, typename V>
+std::pair<T,T> lanes(const V (&lo)[4], const V (&hi)[4], std::pair<T,T> r) noexcept
+{
+   constexpr std::size_t n{4*sizeof(V)/sizeof(T)};
+   T a[n];
+   if constexpr(op::max!=O) {
+      std::memcpy(a,lo,sizeof a);
+      r.first = std::min(r.first,*std::min_element(a,a+n));
+   }
+   if constexpr(op::min!=O) {
+      std::memcpy(a,hi,sizeof a);
+      r.second = std::max(r.second,*std::max_element(a,a+n));
+   }
+   return r;
+}
+
+/**
+   Four vectors of running minima (maxima) at a time, the rest of 's' by the scalar loop. Loads are 'memcpy', i.e. unaligned moves.
+*/
+template <op O, typename T>
+REDUCE_AVX2 std::pair<T,T> avx2_kernel(std::span<const T> s) noexcept
+{
+   using L = avx2<T>;
+   using vec = typename L::vec;
+   constexpr std::size_t n{sizeof(vec)/sizeof(T)};
+   vec lo[4], hi[4];
+   T a[n];
+   std::fill_n(a,n,greatest<T>());
+   for(auto& v: lo)
+      std::memcpy(&v,a,sizeof v);
+   std::fill_n(a,n,lowest<T>());
+   for(auto& v: hi)
+      std::memcpy(&v,a,sizeof v);
+   const T* p = s.data();
+   std::size_t i{0};
+   for(; i+4*n<=s.size(); i+=4*n)
+      for(std::size_t k=0; k<4; ++k) {
+         vec v;
+         std::memcpy(&v,p+i+k*n,sizeof v);
+         if constexpr(op::max!=O)
+            lo[k] = L::min(lo[k],v);
+         if constexpr(op::min!=O)
+            hi[k] = L::max(hi[k],v);
+      }
+   return lanes<O,T>(lo,hi,scalar<O,T>(s.subspan(i)));
+}
+
+template <op O, typename T>
+REDUCE_AVX512 std::pair<T,T> avx512_kernel(std::span<const T> s) noexcept
+{
+   using L = avx512<T>;
+   using vec = typename L::vec;
+   constexpr std::size_t n{sizeof(vec)/sizeof(T)};
+   vec lo[4], hi[4];
+   T a[n];
+   std::fill_n(a,n,greatest<T>());
+   for(auto& v: lo)
+      std::memcpy(&v,a,sizeof v);
+   std::fill_n(a,n,lowest<T>());
+   for(auto& v: hi)
+      std::memcpy(&v,a,sizeof v);
+   const T* p = s.data();
+   std::size_t i{0};
+   for(; i+4*n<=s.size(); i+=4*n)
+      for(std::size_t k=0; k<4; ++k) {
+         vec v;
+         std::memcpy(&v,p+i+k*n,sizeof v);
+         if constexpr(op::max!=O)
+            lo[k] = L::min(lo[k],v);
+         if constexpr(op::min!=O)
+            hi[k] = L::max(hi[k],v);
+      }
+   return lanes<O,T>(lo,hi,scalar<O,T>(s.subspan(i)));
+}
+
+#undef REDUCE_AVX2
+#undef REDUCE_AVX512
+
+}  // end of namespace private_
+
+template <op O, typename T>
+std::pair<T,T> avx2(std::span<const T> s) noexcept
+{
+   if constexpr(private_::has_lanes<T>)
+      return private_::avx2_kernel<O,T>(s);
+   else
+      return scalar<O,T>(s);
+}
+
+template <op O, typename T>
+std::pair<T,T> avx512(std::span<const T> s) noexcept
+{
+   if constexpr(private_::has_lanes<T>)
+      return private_::avx512_kernel<O,T>(s);
+   else
+      return scalar<O,T>(s);
+}
+
+#endif // CPU_X86
+
+/**
+   \retval {min,max} of 's' by the best kernel of this CPU, in one thread
+*/
+template <op O, typename T>
+std::pair<T,T> best(std::span<const T> s) noexcept
+{
+#ifdef CPU_X86
+   if(cpu::features().avx512f)
+      return avx512<O,T>(s);
+   if(cpu::features().avx2)
+      return avx2<O,T>(s);
+#endif
+   return scalar<O,T>(s);
+}
+
+constexpr std::size_t parallel_threshold{1<<22};   // elements, fewer are not worth the threads
+
+/**
+   \retval {min,max} of 's', its parts reduced by 'jobs' threads
+*/
+template <op O, typename T>
+std::pair<T,T> apply(std::span<const T> s, std::size_t jobs)
+{
+   jobs = std::min(std::max<std::size_t>(jobs,1),std::max<std::size_t>(s.size()/(parallel_threshold/4),1));
+   if(1==jobs)
+      return best<O,T>(s);
+   std::vector<std::pair<T,T>> results(jobs);
+   const auto work = [&](std::size_t k) {
+      const auto size = s.size()/jobs;
+      results[k] = best<O,T>(s.subspan(size*k,k+1<jobs? size : s.size()-size*k));
+   };
+   std::vector<std::thread> threads;
+   for(std::size_t k=1; k<jobs; ++k)
+      threads.emplace_back(work,k);
+   work(0);
+   for(auto& t: threads)
+      t.join();
+   auto r = results[0];
+   for(std::size_t k=1; k<jobs; ++k)
+      r = {std::min(r.first,results[k].first),std::max(r.second,results[k].second)};
+   return r;
+}
+
+template <op O, typename T>
+std::pair<T,T> apply(std::span<const T> s)
+{
+   return apply<O,T>(s,s.size()<parallel_threshold? 1 : std::thread::hardware_concurrency());
+}
+
+template <typename T>
+T min(std::span<const T> s) { return apply<op::min,T>(s).first; }
+
+template <typename T>
+T max(std::span<const T> s) { return apply<op::max,T>(s).second; }
+
+/**
+   \retval {min,max} of 's' in one pass
+*/
+template <typename T>
+std::pair<T,T> minmax(std::span<const T> s) { return apply<op::minmax,T>(s); }
+
+}  // end of namespace reduce
+
+#endif // CONSTEXPR_MIN_MAX_REDUCE_H_
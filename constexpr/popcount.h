@@ -0,0 +1,162 @@
+#ifndef CONSTEXPR_POPCOUNT_H_
+#define CONSTEXPR_POPCOUNT_H_
+
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+
+#include "cpu.h"
+
+/**
+   Population count of a whole buffer, the run-time counterpart of 'compilertime::sparse'.
+
+   Kernels, from the most portable to the fastest:
+      scalar      : 'std::popcount' word by word, the 'popcnt' instruction if the target has it, a bit trick otherwise
+      harley_seal : a carry-save adder over 16 words, only one 'popcount' per 16 words remains  (portable C++)
+      avx2        : 4 bits at a time looked up in a table of 16 by 'vpshufb', summed up by 'vpsadbw'
+      avx512      : 'vpopcntq' of 8 words at a time (AVX-512 VPOPCNTDQ)
+   The SIMD kernels are compiled for their own instruction set regardless of the compiler flags,
+   'popcount' calls the best one which the CPU supports, as CPUID tells on the first call.
+
+   \see http://0x80.pl/articles/sse-popcount.html
+   \see https://arxiv.org/abs/1611.07612 "Faster Population Counts Using AVX2 Instructions" by Wojciech Muła, Nathan Kurz, Daniel Lemire
+*/
+
+namespace bulk
+{
+
+using words = std::span<const std::uint64_t>;
+
+inline std::size_t scalar(words w) noexcept
+{
+    std::size_t count{0};
+    for(const auto v: w)
+        count += std::popcount(v);
+    return count;
+}
+
+namespace private_
+{
+
+inline void csa(std::uint64_t& high, std::uint64_t& low, std::uint64_t a, std::uint64_t b, std::uint64_t c) noexcept
+{   // carry-save adder: 'high' gets the carries, 'low' the sums of the bits of a+b+c
+    const std::uint64_t u = a^b;
+    high = (a&b)|(u&c);
+    low = u^c;
+}
+
+}   // end of namespace 'private_'
+
+inline std::size_t harley_seal(words w) noexcept
+{
+    using private_::csa;
+    std::uint64_t total{0}, ones{0}, twos{0}, fours{0}, eights{0}, sixteens;
+    std::uint64_t twos_a, twos_b, fours_a, fours_b, eights_a, eights_b;
+    const std::uint64_t* d = w.data();
+    std::size_t i{0};
+    for(; i+16<=w.size(); i+=16) {
+        csa(twos_a,ones,ones,d[i+0],d[i+1]);
+        csa(twos_b,ones,ones,d[i+2],d[i+3]);
+        csa(fours_a,twos,twos,twos_a,twos_b);
+        csa(twos_a,ones,ones,d[i+4],d[i+5]);
+        csa(twos_b,ones,ones,d[i+6],d[i+7]);
+        csa(fours_b,twos,twos,twos_a,twos_b);
+        csa(eights_a,fours,fours,fours_a,fours_b);
+        csa(twos_a,ones,ones,d[i+8],d[i+9]);
+        csa(twos_b,ones,ones,d[i+10],d[i+11]);
+        csa(fours_a,twos,twos,twos_a,twos_b);
+        csa(twos_a,ones,ones,d[i+12],d[i+13]);
+        csa(twos_b,ones,ones,d[i+14],d[i+15]);
+        csa(fours_b,twos,twos,twos_a,twos_b);
+        csa(eights_b,fours,fours,fours_a,fours_b);
+        csa(sixteens,eights,eights,eights_a,eights_b);
+        total += std::popcount(sixteens);
+    }
+    total = 16*total+8*std::popcount(eights)+4*std::popcount(fours)+2*std::popcount(twos)+std::popcount(ones);
+    return total+scalar(w.subspan(i));
+}
+
+#ifdef CPU_X86
+
+CPU_TARGET("avx2") inline std::size_t avx2(words w) noexcept
+{
+    const __m256i lookup = _mm256_setr_epi8(0,1,1,2,1,2,2,3,1,2,2,3,2,3,3,4,
+                                            0,1,1,2,1,2,2,3,1,2,2,3,2,3,3,4);
+    const __m256i low = _mm256_set1_epi8(0x0F);
+    __m256i total = _mm256_setzero_si256();
+    const std::uint64_t* d = w.data();
+    std::size_t i{0};
+    while(i+4<=w.size()) {
+        // a byte counts at most 8 a time, 31 times fit into it before 'vpsadbw' has to widen the counts
+        __m256i bytes = _mm256_setzero_si256();
+        for(int k=0; k<31 && i+4<=w.size(); ++k, i+=4) {
+            const __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(d+i));
+            const __m256i lo = _mm256_shuffle_epi8(lookup,_mm256_and_si256(v,low));
+            const __m256i hi = _mm256_shuffle_epi8(lookup,_mm256_and_si256(_mm256_srli_epi16(v,4),low));
+            bytes = _mm256_add_epi8(bytes,_mm256_add_epi8(lo,hi));
+        }
+        total = _mm256_add_epi64(total,_mm256_sad_epu8(bytes,_mm256_setzero_si256()));
+    }
+    const std::size_t count = _mm256_extract_epi64(total,0)+_mm256_extract_epi64(total,1)
+                             +_mm256_extract_epi64(total,2)+_mm256_extract_epi64(total,3);
+    return count+scalar(w.subspan(i));
+}
+
+CPU_TARGET("avx512f,avx512vpopcntdq") inline std::size_t avx512(words w) noexcept
+{
+    __m512i total = _mm512_setzero_si512();
+    const std::uint64_t* d = w.data();
+    std::size_t i{0};
+    for(; i+8<=w.size(); i+=8)
+        total = _mm512_add_epi64(total,_mm512_popcnt_epi64(_mm512_loadu_si512(d+i)));
+    const __mmask8 tail = static_cast<__mmask8>((1u<<(w.size()-i))-1);
+    total = _mm512_add_epi64(total,_mm512_popcnt_epi64(_mm512_maskz_loadu_epi64(tail,d+i)));
+    std::uint64_t lanes[8];
+    _mm512_storeu_si512(lanes,total);
+    return lanes[0]+lanes[1]+lanes[2]+lanes[3]+lanes[4]+lanes[5]+lanes[6]+lanes[7];
+}
+
+#endif // CPU_X86
+
+using kernel = std::size_t(*)(words) noexcept;
+
+/**
+   \retval the fastest kernel of this CPU
+*/
+inline kernel best() noexcept
+{
+#ifdef CPU_X86
+    if(cpu::features().avx512vpopcntdq)
+        return avx512;
+    if(cpu::features().avx2)
+        return avx2;
+#endif
+    return harley_seal;
+}
+
+inline std::size_t popcount(words w) noexcept
+{
+    static const kernel k = best();
+    return k(w);
+}
+
+/**
+   Every kernel this CPU can run, by name.
+*/
+template <typename F>
+void for_each_kernel(F f)
+{
+    f("scalar",scalar);
+    f("harley_seal",harley_seal);
+#ifdef CPU_X86
+    if(cpu::features().avx2)
+        f("avx2",avx2);
+    if(cpu::features().avx512vpopcntdq)
+        f("avx512",avx512);
+#endif
+}
+
+}   // end of namespace 'bulk'
+
+#endif // CONSTEXPR_POPCOUNT_H_
@@ -0,0 +1,140 @@
+/**
+   Sequential 'fs_process' versus the parallel walker on a synthetic tree.
+   The tree is generated once under <scratch> (1'000 files per directory, 100 directories per level)
+   and reused by the next runs. <scratch> has to be missing, empty or a tree of this benchmark, nothing else is ever deleted. The listing goes to /dev/null, so only traversal and formatting are measured.
+
+   Then the synchronous 'fs_process' versus the io_uring walker on a slow volume, simulated on one directory of the tree:
+   the synchronous walk sleeps before every entry, the asynchronous one delays every statx by a linked timeout.
+
+   Before that the watch mode is checked under <scratch>/.watch: a watched directory renamed to a name sorted before
+   its old one has to stay watched, a file written into it afterwards has to be counted.
+
+   Usage: benchmark <scratch> [entries=1000000] [jobs=hardware_concurrency]
+*/
+
+#include <chrono>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <thread>
+
+#include "listing.h"
+#include "parallel_walker.h"
+#include "uring_walker.h"
+#include "watch.h"
+
+#include <fcntl.h>
+
+using namespace std;
+
+bool check_watch(out::writer& null, const fs::path& dir)
+{
+   fs::remove_all(dir);
+   fs::create_directories(dir / "zdir");
+   ofstream{dir / "zdir" / "old"} << string(1000,'x');
+
+   watch::tree t{null,dir,chrono::milliseconds{50}};
+   fs::rename(dir / "zdir",dir / "adir");
+   t.process();
+   ofstream{dir / "adir" / "new"} << string(5000,'x');
+   t.process();
+
+   const auto* n = t.find(dir / "adir");
+   const bool ok = n && 6000==n->bytes && 2==n->files && !t.find(dir / "zdir") && 6000==t.find(dir)->bytes && 2==t.watched();
+   fs::remove_all(dir);
+   return ok;
+}
+
+void generate(const fs::path& root, size_t entries)
+{
+   constexpr size_t files_per_dir{1'000};
+   constexpr size_t dirs_per_level{100};
+
+   size_t created{0};
+   for(size_t d=0; created<entries; ++d) {
+      const auto dir = root / to_string(d/dirs_per_level) / to_string(d%dirs_per_level);
+      fs::create_directories(dir);
+      for(size_t f=0; f<files_per_dir && created<entries; ++f, ++created)
+         ofstream{dir / to_string(f)} << f;
+   }
+}
+
+template <typename F>
+double measure(F f)
+{
+   const auto start = chrono::steady_clock::now();
+   f();
+   return chrono::duration<double>(chrono::steady_clock::now()-start).count();
+}
+
+int run(out::writer& null, const fs::path& root, size_t jobs)
+{
+   if(!check_watch(null,root / ".watch")) {
+      cout << "the watched tree is wrong after a rename" << endl;
+      return 2;
+   }
+
+   cout << "sequential fs_process:     " << measure([&]{ fs_process(null,{root,fs::status(root)}); }) << " s" << endl;
+   cout << "parallel  (jobs=" << jobs << "):        " << measure([&]{ fs_process(null,root,jobs,false); }) << " s" << endl;
+   cout << "parallel  (jobs=" << jobs << ",ordered):" << measure([&]{ fs_process(null,root,jobs,true);  }) << " s" << endl;
+
+   if(!uring_::available()) {
+      cout << "io_uring is not available" << endl;
+      return 0;
+   }
+   cout << "io_uring  (depth=" << uring_::walker::default_depth << "):       " << measure([&]{ fs_process_uring(null,root); }) << " s" << endl;
+
+   const auto dir = root / "0" / "0";
+   for(const auto latency: {chrono::microseconds{100},chrono::microseconds{1'000},chrono::microseconds{10'000}}) {
+      cout << "latency " << latency.count() << " us per stat, " << dir << ":" << endl;
+      cout << "   synchronous fs_process: " << measure([&]{
+         fs_walk({dir,fs::status(dir)},[&](const fs_entity& e){
+            this_thread::sleep_for(latency);
+            return fs_visit(null,e);
+         });
+      }) << " s" << endl;
+      for(const unsigned depth: {16u,256u})
+         cout << "   io_uring (depth=" << setw(3) << depth << "):    " << measure([&]{
+            uring_::walker{null,fs_max_open,depth,latency}.run(dir);
+         }) << " s" << endl;
+   }
+   return 0;
+}
+
+int main(int argc, char *argv[])
+{
+   if(argc < 2) {
+      cout << "Usage: " << argv[0] << " <scratch> [entries] [jobs]" << endl;
+      return 1;
+   }
+   const fs::path root{argv[1]};
+   const size_t entries = argc>2? stoul(argv[2]) : 1'000'000;
+   const size_t jobs    = argc>3? stoul(argv[3]) : max(1u,thread::hardware_concurrency());
+
+   const auto owned = root / ".benchmark";   // written first, so that a tree of another size may be deleted
+   if(fs::exists(root) && !fs::is_empty(root) && !fs::exists(owned)) {
+      cout << root << " is neither empty nor generated by this benchmark" << endl;
+      return 1;
+   }
+   const auto marker = root / ("." + to_string(entries));
+   if(!fs::exists(marker)) {
+      cout << "generating " << entries << " files under " << root << " ..." << endl;
+      if(fs::exists(root))
+         for(const auto& e: fs::directory_iterator{root})
+            fs::remove_all(e.path());
+      fs::create_directories(root);
+      ofstream{owned};
+      generate(root,entries);
+      ofstream{marker};
+   }
+
+   const int fd = ::open("/dev/null",O_WRONLY);
+   int result;
+   {
+      out::writer null{fd};
+      result = run(null,root,jobs);
+   }   // flushed before its descriptor is closed
+   ::close(fd);
+   return result;
+}
@@ -0,0 +1,300 @@
+#ifndef FS_DIRENT_WALKER_H_
+#define FS_DIRENT_WALKER_H_
+
+#include "listing.h"
+
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <memory>
+#include <ostream>
+#include <string>
+#include <system_error>
+#include <vector>
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+/**
+   Linux backend of 'fs_process'.
+   Every entry of 'fs::directory_iterator' costs a readdir, then 'fs::status' and 'fs::file_size' resolve the full path once again,
+   i.e. at least three syscalls per file.
+   Here a directory is read by large getdents64 buffers and its entries are examined relative to the open directory descriptor:
+   - 'd_type' already tells the type, so no stat at all is needed when only the type is required ('brief' listing);
+   - otherwise a single 'statx' is issued with only those fields in the mask which are going to be printed.
+   The order of entries is the one of readdir, so the output is the same as of the portable 'fs_process'.
+
+   \see https://man7.org/linux/man-pages/man2/getdents.2.html
+   \see https://man7.org/linux/man-pages/man2/statx.2.html
+*/
+
+namespace dirent_
+{
+
+struct counters
+{
+   std::uint64_t entries{0};
+   std::uint64_t getdents{0};
+   std::uint64_t statx{0};
+   std::uint64_t openat{0};
+   std::uint64_t close{0};
+
+   std::uint64_t syscalls() const noexcept { return getdents+statx+openat+close; }
+};
+
+inline std::ostream& operator<<(std::ostream& os, const counters& c)
+{
+   os    << "entries: " << c.entries
+         << ", getdents64: " << c.getdents
+         << ", statx: " << c.statx
+         << ", openat: " << c.openat
+         << ", close: " << c.close
+         << ", syscalls per entry: " << (c.entries? double(c.syscalls())/c.entries : 0.);
+   return os;
+}
+
+inline fs::file_type from_dtype(unsigned char t) noexcept
+{
+   switch(t) {
+      case DT_REG    : return fs::file_type::regular;
+      case DT_DIR    : return fs::file_type::directory;
+      case DT_LNK    : return fs::file_type::symlink;
+      case DT_BLK    : return fs::file_type::block;
+      case DT_CHR    : return fs::file_type::character;
+      case DT_FIFO   : return fs::file_type::fifo;
+      case DT_SOCK   : return fs::file_type::socket;
+      default        : break;
+   }
+   return fs::file_type::unknown;
+}
+
+inline fs::file_type from_mode(unsigned mode) noexcept
+{
+   switch(mode & S_IFMT) {
+      case S_IFREG   : return fs::file_type::regular;
+      case S_IFDIR   : return fs::file_type::directory;
+      case S_IFLNK   : return fs::file_type::symlink;
+      case S_IFBLK   : return fs::file_type::block;
+      case S_IFCHR   : return fs::file_type::character;
+      case S_IFIFO   : return fs::file_type::fifo;
+      case S_IFSOCK  : return fs::file_type::socket;
+      default        : break;
+   }
+   return fs::file_type::unknown;
+}
+
+[[noreturn]] inline void fail(const char* what, const std::string& path)
+{
+   throw fs::filesystem_error{what,path,std::error_code{errno,std::generic_category()}};
+}
+
+struct linux_dirent64
+{
+   std::uint64_t  d_ino;
+   std::int64_t   d_off;
+   unsigned short d_reclen;
+   unsigned char  d_type;
+   char           d_name[1];
+};
+
+inline bool is_dot(const char* n) noexcept
+{
+   return '.'==n[0] && ('\0'==n[1] || ('.'==n[1] && '\0'==n[2]));
+}
+
+/**
+   Iterative walk with an explicit stack of open directories.
+   Every stack frame is a directory descriptor plus a getdents64 buffer taken from a pool, so the buffers are allocated once
+   and reused by all directories of the tree. At most 'max_open' descriptors are open at once.
+   When the stack is full, subdirectories are spilled into a queue and walked breadth first after the stack has drained,
+   so neither descriptors nor memory grow with the depth of a tree.
+*/
+class walker
+{
+public:
+   static constexpr std::size_t buffer_size{64*1024};
+
+   /**
+      \param 'brief' prints type and path only, the information 'd_type' gives for free
+      \param 'max_open' is a limit of simultaneously open directory descriptors
+   */
+   walker(out::writer& os, bool brief, std::size_t max_open = fs_max_open)
+      :  os_(os)
+        ,brief_(brief)
+        ,max_open_(std::max<std::size_t>(max_open,1))
+   {
+      stack_.reserve(max_open_);
+   }
+
+   ~walker()
+   {
+      while(!stack_.empty())
+         pop();
+   }
+
+   walker(const walker&) = delete;
+   walker& operator=(const walker&) = delete;
+
+   void run(const std::string& path)
+   {
+      path_ = path;
+      struct statx st;
+      if(!stat(AT_FDCWD,path.c_str(),STATX_TYPE|STATX_MODE|STATX_SIZE,st))
+         return;
+      const auto type = from_mode(st.stx_mode);
+      print(type,st);
+      if(fs::file_type::directory!=type)
+         return;
+
+      spill_.push_back(path);
+      while(!spill_.empty()) {
+         path_ = std::move(spill_.front());
+         spill_.pop_front();
+         push(AT_FDCWD,path_.c_str());
+         walk();
+      }
+   }
+
+   const counters& stats() const noexcept { return c_; }
+
+private:
+   struct frame
+   {
+      int                     fd;
+      std::unique_ptr<char[]> buffer;
+      long                    pos;
+      long                    size;
+      std::size_t             length;   // of the directory path in 'path_'
+   };
+
+   void walk()
+   {
+      while(!stack_.empty()) {
+         auto& f = stack_.back();
+         const auto* d = next(f);
+         if(!d) {
+            pop();
+            continue;
+         }
+
+         path_.resize(f.length);
+         if(!path_.empty() && '/'!=path_.back())
+            path_ += '/';
+         path_ += d->d_name;
+
+         auto type = from_dtype(d->d_type);
+         struct statx st{};
+         if(!brief_ || fs::file_type::unknown==type || fs::file_type::symlink==type) {
+            unsigned mask = STATX_TYPE|STATX_MODE;
+            if(fs::file_type::directory!=type)
+               mask |= STATX_SIZE;
+            if(!stat(f.fd,d->d_name,mask,st))
+               continue;
+            type = from_mode(st.stx_mode);
+         }
+         print(type,st);
+         if(fs::file_type::directory!=type)
+            continue;
+         if(stack_.size()<max_open_)
+            push(f.fd,d->d_name);
+         else
+            spill_.push_back(path_);
+      }
+   }
+
+   const linux_dirent64* next(frame& f)
+   {
+      for(;;) {
+         if(f.pos>=f.size) {
+            ++c_.getdents;
+            f.size = ::syscall(SYS_getdents64,f.fd,f.buffer.get(),buffer_size);
+            f.pos = 0;
+            if(f.size<0)
+               fail("cannot read directory",path_.substr(0,f.length));
+            if(0==f.size)
+               return nullptr;
+         }
+         const auto* d = reinterpret_cast<const linux_dirent64*>(f.buffer.get()+f.pos);
+         f.pos += d->d_reclen;
+         if(!is_dot(d->d_name)) {
+            ++c_.entries;
+            return d;
+         }
+      }
+   }
+
+   void push(int at, const char* name)
+   {
+      ++c_.openat;
+      const int fd = ::openat(at,name,O_RDONLY|O_DIRECTORY|O_CLOEXEC);
+      if(fd<0)
+         fail("cannot open directory",path_);
+      std::unique_ptr<char[]> buffer;
+      if(pool_.empty())
+         buffer.reset(new char[buffer_size]);
+      else {
+         buffer = std::move(pool_.back());
+         pool_.pop_back();
+      }
+      stack_.push_back({fd,std::move(buffer),0,0,path_.size()});
+   }
+
+   void pop()
+   {
+      auto& f = stack_.back();
+      ++c_.close;
+      ::close(f.fd);
+      pool_.push_back(std::move(f.buffer));
+      stack_.pop_back();
+   }
+
+   /**
+      statx follows symbolic links the same way 'fs::status' does.
+      A dangling entry is reported as not existing, any other error is thrown.
+   */
+   bool stat(int at, const char* name, unsigned mask, struct statx& st)
+   {
+      ++c_.statx;
+      if(0==::statx(at,name,AT_STATX_DONT_SYNC,mask,&st))
+         return true;
+      if(ENOENT!=errno)
+         fail("cannot get file status",path_);
+      os_.missing(path_);
+      return false;
+   }
+
+   void print(fs::file_type type, const struct statx& st)
+   {
+      if(brief_)
+         os_.brief(type,path_);
+      else
+         os_.entry(type,fs::perms(st.stx_mode & 07777),fs::file_type::regular==type? st.stx_size : 0,path_);
+   }
+
+   out::writer&                           os_;
+   const bool                             brief_;
+   const std::size_t                      max_open_;
+   std::string                            path_;
+   std::vector<frame>                     stack_;
+   std::vector<std::unique_ptr<char[]>>   pool_;
+   std::deque<std::string>                spill_;
+   counters                               c_;
+};
+
+}  // end of namespace dirent_
+
+/**
+   \retval syscall counters of the walk
+*/
+inline dirent_::counters fs_process_dirent(out::writer& os, const fs::path& p, bool brief, std::size_t max_open = fs_max_open)
+{
+   dirent_::walker w{os,brief,max_open};
+   w.run(p.string());
+   return w.stats();
+}
+
+#endif // FS_DIRENT_WALKER_H_
@@ -0,0 +1,285 @@
+#ifndef FS_DU_H_
+#define FS_DU_H_
+
+#include "dirent_walker.h"
+#include "work_stealing.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <iostream>
+#include <mutex>
+#include <queue>
+#include <string>
+#include <thread>
+#include <unordered_set>
+#include <vector>
+
+#include <sys/sysmacros.h>
+
+/**
+   Disk usage ('du') of a tree computed in one parallel pass.
+
+   Every directory is a 'node' with atomic totals and a counter of outstanding work: its own listing plus one per subdirectory.
+   The worker which brings the counter to zero adds the totals of the node to its parent and releases the parent in turn,
+   so subtree totals are reduced bottom up without any global lock.
+   Files with several hard links are counted once, their (device,inode) pairs are kept in a set split into independently locked shards.
+   The largest directories are collected by every worker into a bounded min-heap, the heaps are merged at the end.
+   Symbolic links are not followed, like 'du' does.
+   An entry removed during the walk is skipped, any other failure is printed and counted ('failed'), so the totals are known to be short.
+
+   \see https://man7.org/linux/man-pages/man1/du.1.html
+*/
+
+namespace du
+{
+
+struct usage
+{
+   std::uint64_t  bytes{0};
+   std::uint64_t  files{0};
+   std::string    path;
+
+   friend bool operator>(const usage& a, const usage& b) noexcept { return a.bytes>b.bytes; }
+};
+
+class inode_set
+{
+public:
+   /**
+      \retval false if the pair has already been seen
+   */
+   bool insert(std::uint64_t dev, std::uint64_t ino)
+   {
+      const key k{dev,ino};
+      auto& s = shards_[hash{}(k)%shards];
+      std::lock_guard lock{s.m};
+      return s.keys.insert(k).second;
+   }
+
+private:
+   static constexpr std::size_t shards{64};
+
+   struct key
+   {
+      std::uint64_t dev, ino;
+      bool operator==(const key& o) const noexcept { return dev==o.dev && ino==o.ino; }
+   };
+
+   struct hash
+   {
+      std::size_t operator()(const key& k) const noexcept
+      {
+         return std::hash<std::uint64_t>{}(k.ino*0x9E3779B97F4A7C15ull ^ k.dev);
+      }
+   };
+
+   struct shard
+   {
+      std::mutex                          m;
+      std::unordered_set<key,hash>        keys;
+   };
+
+   shard shards_[shards];
+};
+
+/**
+   Bounded min-heap: keeps the 'n' largest elements seen.
+*/
+class top_n
+{
+public:
+   explicit top_n(std::size_t n) : n_(n) {}
+
+   void push(usage u)
+   {
+      if(0==n_ || (heap_.size()==n_ && !(u>heap_.top())))
+         return;
+      heap_.push(std::move(u));
+      if(heap_.size()>n_)
+         heap_.pop();
+   }
+
+   void merge(top_n& other)
+   {
+      while(!other.heap_.empty()) {
+         push(other.heap_.top());
+         other.heap_.pop();
+      }
+   }
+
+   /**
+      \retval the kept elements, the largest first
+   */
+   std::vector<usage> sorted()
+   {
+      std::vector<usage> v;
+      for(; !heap_.empty(); heap_.pop())
+         v.push_back(heap_.top());
+      std::reverse(v.begin(),v.end());
+      return v;
+   }
+
+private:
+   std::size_t n_;
+   std::priority_queue<usage,std::vector<usage>,std::greater<usage>> heap_;
+};
+
+class summarizer
+{
+public:
+   summarizer(std::size_t jobs, std::size_t top)
+      :  pool_(jobs)
+   {
+      for(std::size_t i=0; i<pool_.size(); ++i)
+         tops_.emplace_back(top);
+   }
+
+   /**
+      \retval the largest directories, the largest first, and the total of the tree
+   */
+   std::pair<std::vector<usage>,usage> run(const std::string& path)
+   {
+      node root;
+      root.path = path;
+      pool_.push(0,&root);
+
+      std::vector<std::thread> threads;
+      for(std::size_t i=1; i<pool_.size(); ++i)
+         threads.emplace_back([this,i]{ work(i); });
+      work(0);
+      for(auto& t: threads)
+         t.join();
+
+      for(std::size_t i=1; i<tops_.size(); ++i)
+         tops_[0].merge(tops_[i]);
+      return {tops_[0].sorted(),{root.bytes.load(),root.files.load(),path}};
+   }
+
+   /**
+      \retval the number of entries and directories which could not be read, missing from the totals
+   */
+   std::uint64_t failed() const noexcept { return failed_.load(); }
+
+private:
+   struct node
+   {
+      std::string                path;
+      node*                      parent{nullptr};
+      std::atomic<std::int64_t>  outstanding{1};   // own listing + subdirectories
+      std::atomic<std::uint64_t> bytes{0};
+      std::atomic<std::uint64_t> files{0};
+   };
+
+   void work(std::size_t self)
+   {
+      pool_.work(self,[this](std::size_t self, node* n) {
+         try {
+            list(self,*n);
+         }
+         catch(const std::exception& e) {
+            report(e);
+         }
+         release(self,n);
+      });
+   }
+
+   void list(std::size_t self, node& n)
+   {
+      const int fd = ::open(n.path.c_str(),O_RDONLY|O_DIRECTORY|O_CLOEXEC);
+      if(fd<0)
+         dirent_::fail("cannot open directory",n.path);
+      std::uint64_t bytes{0}, files{0};
+      std::vector<char> buffer(dirent_::walker::buffer_size);
+      int error{0};
+      for(;;) {
+         const auto size = ::syscall(SYS_getdents64,fd,buffer.data(),buffer.size());
+         if(size<0)
+            error = errno;
+         if(size<=0)
+            break;
+         for(long pos=0; pos<size;) {
+            const auto* d = reinterpret_cast<const dirent_::linux_dirent64*>(buffer.data()+pos);
+            pos += d->d_reclen;
+            if(dirent_::is_dot(d->d_name))
+               continue;
+            if(DT_DIR==d->d_type) {
+               descend(self,n,d->d_name);
+               continue;
+            }
+            struct statx st;
+            if(0!=::statx(fd,d->d_name,AT_SYMLINK_NOFOLLOW|AT_STATX_DONT_SYNC,STATX_TYPE|STATX_SIZE|STATX_INO|STATX_NLINK,&st)) {
+               if(ENOENT!=errno)
+                  report(fs::filesystem_error{"cannot get file status",fs::path{n.path}/d->d_name,std::error_code{errno,std::generic_category()}});
+               continue;
+            }
+            if(S_ISDIR(st.stx_mode)) {
+               descend(self,n,d->d_name);
+               continue;
+            }
+            if(st.stx_nlink>1 && !links_.insert(::makedev(st.stx_dev_major,st.stx_dev_minor),st.stx_ino))
+               continue;
+            bytes += st.stx_size;
+            ++files;
+         }
+      }
+      ::close(fd);
+      n.bytes.fetch_add(bytes,std::memory_order_relaxed);   // what has been read until an error counts
+      n.files.fetch_add(files,std::memory_order_relaxed);
+      if(error) {
+         errno = error;
+         dirent_::fail("cannot read directory",n.path);
+      }
+   }
+
+   void report(const std::exception& e)
+   {
+      ++failed_;
+      std::lock_guard lock{errors_};
+      std::cerr << e.what() << std::endl;
+   }
+
+   void descend(std::size_t self, node& n, const char* name)
+   {
+      auto* child = new node;
+      child->path = n.path;
+      if(child->path.empty() || '/'!=child->path.back())
+         child->path += '/';
+      child->path += name;
+      child->parent = &n;
+      n.outstanding.fetch_add(1,std::memory_order_relaxed);
+      pool_.push(self,child);
+   }
+
+   /**
+      The last one who leaves the node reports it and hands its totals over to the parent.
+   */
+   void release(std::size_t self, node* n)
+   {
+      while(n && 1==n->outstanding.fetch_sub(1,std::memory_order_acq_rel)) {
+         const auto bytes = n->bytes.load(std::memory_order_relaxed);
+         const auto files = n->files.load(std::memory_order_relaxed);
+         auto* parent = n->parent;
+         if(parent) {
+            parent->bytes.fetch_add(bytes,std::memory_order_relaxed);
+            parent->files.fetch_add(files,std::memory_order_relaxed);
+            tops_[self].push({bytes,files,std::move(n->path)});
+            delete n;
+         }
+         else
+            tops_[self].push({bytes,files,n->path});
+         n = parent;
+      }
+   }
+
+   parallel::work_stealing_pool<node*> pool_;
+   std::vector<top_n>                  tops_;
+   inode_set                           links_;
+   std::mutex                          errors_;
+   std::atomic<std::uint64_t>          failed_{0};
+};
+
+}  // end of namespace du
+
+#endif // FS_DU_H_
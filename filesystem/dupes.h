@@ -0,0 +1,291 @@
+#ifndef FS_DUPES_H_
+#define FS_DUPES_H_
+
+#include "listing.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <tuple>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+/**
+   Duplicate files of a tree found by staged filtering, so that only a small fraction of the data is ever read:
+   1) files are grouped by size, a file of unique size has no duplicates;
+   2) candidates are grouped by a hash of their first 4 KiB, read by a single pread;
+   3) only files whose prefixes collide are hashed completely, through a read-only mapping.
+   Hashing is spread over a pool of threads. Hard links (and symbolic links) to the same inode are the same file, not duplicates.
+
+   The hash is MurmurHash3 x64 128-bit, a fast non-cryptographic one.
+   \see https://github.com/aappleby/smhasher/blob/master/src/MurmurHash3.cpp
+*/
+
+namespace dupes
+{
+
+struct hash128
+{
+   std::uint64_t lo{0}, hi{0};
+
+   friend bool operator==(const hash128& a, const hash128& b) noexcept { return a.lo==b.lo && a.hi==b.hi; }
+   friend bool operator<(const hash128& a, const hash128& b) noexcept { return std::tie(a.hi,a.lo)<std::tie(b.hi,b.lo); }
+};
+
+namespace murmur3
+{
+   constexpr std::uint64_t c1{0x87c37b91114253d5ull};
+   constexpr std::uint64_t c2{0x4cf5ad432745937full};
+
+   constexpr std::uint64_t rotl(std::uint64_t x, int r) noexcept { return (x<<r)|(x>>(64-r)); }
+
+   constexpr std::uint64_t fmix(std::uint64_t k) noexcept
+   {
+      k ^= k>>33;
+      k *= 0xff51afd7ed558ccdull;
+      k ^= k>>33;
+      k *= 0xc4ceb9fe1a85ec53ull;
+      k ^= k>>33;
+      return k;
+   }
+
+   inline std::uint64_t load(const unsigned char* p) noexcept
+   {
+      std::uint64_t v;
+      std::memcpy(&v,p,sizeof(v));
+      return v;
+   }
+}  // end of namespace murmur3
+
+inline hash128 hash(const void* data, std::size_t size, std::uint64_t seed = 0) noexcept
+{
+   using namespace murmur3;
+   const auto* p = static_cast<const unsigned char*>(data);
+   std::uint64_t h1{seed}, h2{seed};
+
+   const auto blocks = size/16;
+   for(std::size_t i=0; i<blocks; ++i, p+=16) {
+      auto k1 = load(p);
+      auto k2 = load(p+8);
+      k1 *= c1; k1 = rotl(k1,31); k1 *= c2; h1 ^= k1;
+      h1 = rotl(h1,27); h1 += h2; h1 = h1*5+0x52dce729;
+      k2 *= c2; k2 = rotl(k2,33); k2 *= c1; h2 ^= k2;
+      h2 = rotl(h2,31); h2 += h1; h2 = h2*5+0x38495ab5;
+   }
+
+   std::uint64_t k1{0}, k2{0};
+   const auto tail = size & 15;
+   for(auto i=tail; i>8; --i)
+      k2 ^= std::uint64_t{p[i-1]} << ((i-9)*8);
+   if(tail>8) {
+      k2 *= c2; k2 = rotl(k2,33); k2 *= c1; h2 ^= k2;
+   }
+   for(auto i=std::min<std::size_t>(tail,8); i>0; --i)
+      k1 ^= std::uint64_t{p[i-1]} << ((i-1)*8);
+   if(tail) {
+      k1 *= c1; k1 = rotl(k1,31); k1 *= c2; h1 ^= k1;
+   }
+
+   h1 ^= size; h2 ^= size;
+   h1 += h2; h2 += h1;
+   h1 = fmix(h1); h2 = fmix(h2);
+   h1 += h2; h2 += h1;
+   return {h1,h2};
+}
+
+struct counters
+{
+   std::uint64_t files{0};
+   std::uint64_t bytes{0};          // total size of all files
+   std::uint64_t by_size{0};        // candidates after grouping by size
+   std::uint64_t by_prefix{0};      // candidates after grouping by prefix hash
+   std::uint64_t duplicates{0};
+   std::uint64_t read{0};           // bytes actually read
+};
+
+inline std::ostream& operator<<(std::ostream& os, const counters& c)
+{
+   os    << "files: " << c.files
+         << ", same size: " << c.by_size
+         << ", same prefix: " << c.by_prefix
+         << ", duplicates: " << c.duplicates
+         << ", bytes read: " << c.read << " of " << c.bytes
+         << " (" << (c.bytes? 100.*c.read/c.bytes : 0.) << "%)";
+   return os;
+}
+
+/**
+   Calls f(i) for i in [0,n) on 'jobs' threads.
+*/
+template <typename F>
+void parallel_for(std::size_t n, std::size_t jobs, F f)
+{
+   std::atomic<std::size_t> next{0};
+   const auto work = [&]{
+      for(auto i=next++; i<n; i=next++)
+         f(i);
+   };
+   std::vector<std::thread> threads;
+   for(std::size_t i=1; i<std::min(jobs,n); ++i)
+      threads.emplace_back(work);
+   work();
+   for(auto& t: threads)
+      t.join();
+}
+
+class finder
+{
+public:
+   static constexpr std::size_t prefix_size{4*1024};
+
+   struct file
+   {
+      std::string    path;
+      std::uint64_t  size{0};
+      std::uint64_t  dev{0}, ino{0};
+      hash128        prefix, full;
+      bool           failed{false};
+   };
+
+   explicit finder(std::size_t jobs) : jobs_(jobs? jobs : 1) {}
+
+   /**
+      Collects regular non-empty files of the tree 'p'.
+   */
+   void scan(const fs::path& p)
+   {
+      fs_walk({p,fs::status(p)},[this](const fs_entity& e){
+         const auto& [path,status] = e;
+         if(fs::file_type::regular==status.type())
+            if(const auto size = fs_bytes(e)) {
+               files_.push_back({path.native(),size,0,0,{},{},false});
+               ++c_.files;
+               c_.bytes += size;
+            }
+         return fs::file_type::directory==status.type();
+      });
+   }
+
+   /**
+      \retval groups of identical files, the largest files first
+   */
+   std::vector<std::vector<const file*>> run()
+   {
+      std::vector<file*> v;
+      for(auto& f: files_)
+         v.push_back(&f);
+
+      // 1) size; the same inode reached by several paths is one file
+      std::sort(v.begin(),v.end(),[](const file* a, const file* b){ return a->size<b->size; });
+      v = keep(std::move(v),[](const file* a, const file* b){ return a->size==b->size; });
+      parallel_for(v.size(),jobs_,[&v](std::size_t i){
+         struct stat st;
+         v[i]->failed = 0!=::stat(v[i]->path.c_str(),&st) || std::uint64_t(st.st_size)!=v[i]->size;
+         if(v[i]->failed)
+            return;
+         v[i]->dev = st.st_dev;
+         v[i]->ino = st.st_ino;
+      });
+      v.erase(std::remove_if(v.begin(),v.end(),[](const file* f){ return f->failed; }),v.end());   // before 'unique' compares their inodes
+      std::sort(v.begin(),v.end(),[](const file* a, const file* b){ return std::tie(a->size,a->dev,a->ino)<std::tie(b->size,b->dev,b->ino); });
+      v.erase(std::unique(v.begin(),v.end(),[](const file* a, const file* b){ return a->dev==b->dev && a->ino==b->ino; }),v.end());
+      v = keep(std::move(v),[](const file* a, const file* b){ return a->size==b->size; });
+      c_.by_size = v.size();
+
+      // 2) hash of the first bytes
+      parallel_for(v.size(),jobs_,[this,&v](std::size_t i){ hash_prefix(*v[i]); });
+      std::sort(v.begin(),v.end(),[](const file* a, const file* b){ return std::tie(a->size,a->prefix)<std::tie(b->size,b->prefix); });
+      v = keep(std::move(v),[](const file* a, const file* b){ return a->size==b->size && a->prefix==b->prefix; });
+      c_.by_prefix = v.size();
+
+      // 3) hash of the whole content, unless the prefix is the whole content
+      parallel_for(v.size(),jobs_,[this,&v](std::size_t i){ hash_full(*v[i]); });
+      std::sort(v.begin(),v.end(),[](const file* a, const file* b){ return std::tie(a->size,a->prefix,a->full)<std::tie(b->size,b->prefix,b->full); });
+      v = keep(std::move(v),[](const file* a, const file* b){ return a->size==b->size && a->prefix==b->prefix && a->full==b->full; });
+      c_.duplicates = v.size();
+      c_.read = read_;
+
+      std::vector<std::vector<const file*>> groups;
+      for(auto it=v.rbegin(); it!=v.rend(); ++it) {
+         if(groups.empty() || !((*it)->full==groups.back().back()->full && (*it)->size==groups.back().back()->size))
+            groups.emplace_back();
+         groups.back().push_back(*it);
+      }
+      for(auto& g: groups)
+         std::sort(g.begin(),g.end(),[](const file* a, const file* b){ return a->path<b->path; });
+      return groups;
+   }
+
+   const counters& stats() const noexcept { return c_; }
+
+private:
+   /**
+      Keeps the elements of runs longer than one in a sorted sequence, failed files are dropped.
+   */
+   template <typename Same>
+   static std::vector<file*> keep(std::vector<file*> v, Same same)
+   {
+      v.erase(std::remove_if(v.begin(),v.end(),[](const file* f){ return f->failed; }),v.end());
+      std::vector<file*> kept;
+      for(std::size_t i=0, j=0; i<v.size(); i=j) {
+         for(j=i+1; j<v.size() && same(v[i],v[j]); ++j)
+            ;
+         if(j-i>1)
+            kept.insert(kept.end(),v.begin()+i,v.begin()+j);
+      }
+      return kept;
+   }
+
+   void hash_prefix(file& f)
+   {
+      char buffer[prefix_size];
+      const int fd = ::open(f.path.c_str(),O_RDONLY|O_CLOEXEC);
+      const auto n = fd<0? -1 : ::pread(fd,buffer,std::min<std::uint64_t>(f.size,prefix_size),0);
+      if(fd>=0)
+         ::close(fd);
+      f.failed = n!=static_cast<ssize_t>(std::min<std::uint64_t>(f.size,prefix_size));   // an error, or shorter than at the walk
+      if(f.failed)
+         return;
+      read_ += n;
+      f.prefix = hash(buffer,n);
+   }
+
+   void hash_full(file& f)
+   {
+      if(f.size<=prefix_size) {
+         f.full = f.prefix;
+         return;
+      }
+      // a page past the end of a file truncated since the walk would raise SIGBUS: a changed file is dropped, not mapped
+      const int fd = ::open(f.path.c_str(),O_RDONLY|O_CLOEXEC);
+      struct stat st;
+      void* p = fd<0 || 0!=::fstat(fd,&st) || std::uint64_t(st.st_size)!=f.size?
+         MAP_FAILED : ::mmap(nullptr,f.size,PROT_READ,MAP_PRIVATE,fd,0);
+      if(fd>=0)
+         ::close(fd);
+      f.failed = MAP_FAILED==p;
+      if(f.failed)
+         return;
+      ::madvise(p,f.size,MADV_SEQUENTIAL);
+      f.full = hash(p,f.size);
+      ::munmap(p,f.size);
+      read_ += f.size;
+   }
+
+   std::size_t                   jobs_;
+   std::vector<file>             files_;
+   std::atomic<std::uint64_t>    read_{0};
+   counters                      c_;
+};
+
+}  // end of namespace dupes
+
+#endif // FS_DUPES_H_
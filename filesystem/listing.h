@@ -0,0 +1,114 @@
+#ifndef FS_LISTING_H_
+#define FS_LISTING_H_
+
+#include <filesystem>
+#include <string>
+#include <utility>
+#include <cstdint>
+#include <deque>
+#include <vector>
+#include <algorithm>
+
+#include "output.h"
+
+/**
+   Entities and the sequential 'fs_process' shared by the other walkers of the example.
+
+   \see https://github.com/nikolaAV/Modern-Cpp/tree/master/filesystem
+*/
+
+using fs_entity = std::pair<fs::path,fs::file_status>;
+
+/**
+   fs::file_size is defined for regular files only (it throws for directories),
+   everything else is shown with zero size.
+*/
+inline std::uintmax_t fs_bytes(const fs_entity& e) noexcept
+{
+   const auto& [path,status] = e;
+   if(status.type()!=fs::file_type::regular)
+      return 0;
+   std::error_code ec;
+   const auto s = fs::file_size(path,ec);
+   return ec? 0 : s;
+}
+
+inline void display(out::writer& w, const fs_entity& e)
+{
+   const auto& [path,status] = e;
+   w.entry(status.type(),status.permissions(),fs_bytes(e),path.native());
+}
+
+/**
+   Prints one entity and tells whether the walker has to descend into it.
+*/
+inline bool fs_visit(out::writer& w, const fs_entity& e)
+{
+   const auto& [path,status] = e;
+
+   if(status.type()==fs::file_type::not_found) {
+      w.missing(path.native());
+      return false;
+   }
+
+   display(w,e);
+   return status.type()==fs::file_type::directory;
+}
+
+/**
+   Default limit of simultaneously open directories for the sequential walkers.
+*/
+constexpr std::size_t fs_max_open{64};
+
+/**
+   Pre-order walk with an explicit stack of open directories instead of the recursion.
+   'visit' is called for every entity and tells whether the walk has to descend into it.
+   At most 'max_open' directories are kept open at once. When the stack is full, subdirectories are spilled into a queue
+   and listed breadth first after the stack has drained, so neither descriptors nor memory grow with the depth of a tree.
+   Until the limit is reached the order is the same as of the recursive walk.
+*/
+template <typename Visit>
+void fs_walk(const fs_entity& e, Visit visit, std::size_t max_open = fs_max_open)
+{
+   if(!visit(e))
+      return;
+
+   std::deque<fs::path> spill{e.first};
+   std::vector<fs::directory_iterator> stack;
+   stack.reserve(max_open);
+
+   while(!spill.empty()) {
+      stack.emplace_back(spill.front());
+      spill.pop_front();
+      while(!stack.empty()) {
+         auto& it = stack.back();
+         if(fs::directory_iterator{}==it) {
+            stack.pop_back();
+            continue;
+         }
+         fs::path subdir;
+         if(visit(fs_entity{*it,it->status()}))
+            subdir = it->path();
+         ++it;
+         if(subdir.empty())
+            continue;
+         if(stack.size()<std::max<std::size_t>(max_open,1))
+            stack.emplace_back(subdir);
+         else
+            spill.push_back(std::move(subdir));
+      }
+   }
+}
+
+inline void fs_process(out::writer& w, const fs_entity& e, std::size_t max_open = fs_max_open)
+{
+   fs_walk(e,[&w](const fs_entity& i){ return fs_visit(w,i); },max_open);
+}
+
+inline void fs_process(const fs::path& p, std::size_t max_open = fs_max_open)
+{
+   out::writer w{STDOUT_FILENO};
+   fs_process(w,{p,fs::status(p)},max_open);
+}
+
+#endif // FS_LISTING_H_
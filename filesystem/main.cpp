@@ -1,108 +1,243 @@
 #include <iostream>
 #include <filesystem>
-#include <sstream>
+#include <string>
+#include <cstdlib>
+#include <cstring>
 #include <iomanip>
+#include <thread>
+
+#include "listing.h"
+#include "parallel_walker.h"
+#include "dirent_walker.h"
+#include "du.h"
+#include "snapshot.h"
+#include "watch.h"
+#include "dupes.h"
+#include "uring_walker.h"
+#include "query.h"
 
 using namespace std;
-namespace fs = std::filesystem;
 
-char fs_type(fs::file_type t) noexcept
+struct options
 {
-   switch(t) {
-      case fs::file_type::regular   : return 'f';
-      case fs::file_type::directory : return 'd';
-      case fs::file_type::symlink   : return 'l';
-      case fs::file_type::block     : return 'b';
-      case fs::file_type::character : return 'c';
-      case fs::file_type::fifo      : return 'p';
-      case fs::file_type::socket    : return 's';
-
-      case fs::file_type::unknown   :
-      case fs::file_type::not_found :
-      case fs::file_type::none      : 
-      default                       : break;
-   }
-   return '?';
-}
+   fs::path path;
+   size_t   jobs{0};       // 0 means the sequential recursive 'fs_process'
+   bool     ordered{false};
+   size_t   max_open{fs_max_open};   // of the sequential walkers
+   string   backend{"std"};   // "std", "dirent" (Linux getdents64 + statx) or "uring" (asynchronous statx)
+   unsigned queue_depth{uring_::walker::default_depth};
+   bool     brief{false};     // type and path only
+   bool     stats{false};     // syscall counters of the dirent backend
+   out::format format{out::format::text};
+   bool     summarize{false};  // disk usage of the tree
+   size_t   top{20};           // largest directories to report
+   string   snapshot;          // file of the incremental rescan
+   bool     watch{false};      // keep the tree live with inotify
+   size_t   window{100};       // of coalescing events, milliseconds
+   bool     duplicates{false}; // groups of identical files
+   bool     query{false};      // filtered and sorted listing
+   query::filter filter;
+   query::order  order{query::order::none};
+   size_t   limit{0};          // of matches, 0 is all
+   size_t   memory{256};       // MiB of matches sorted in memory
+};
 
-string fs_rwx(fs::perms p)
+bool parse(int argc, char *argv[], options& opt)
 {
-   const auto check = [p](fs::perms bit, char c) noexcept {
-      return (p & bit) == fs::perms::none ? '-' : c;
-   };
-   ostringstream oss;
-   oss   << check(fs::perms::owner_read,     'r')
-         << check(fs::perms::owner_write,    'w')
-         << check(fs::perms::owner_exec,     'x')
-         << check(fs::perms::group_read,     'r')
-         << check(fs::perms::group_write,    'w')
-         << check(fs::perms::group_exec,     'x')
-         << check(fs::perms::others_read,    'r')
-         << check(fs::perms::others_write,   'w')
-         << check(fs::perms::others_exec,    'x');
-   return oss.str();
+   bool has_path{false};
+   for(int i=1; i<argc; ++i) {
+      const string arg{argv[i]};
+      if(arg=="--jobs" && i+1<argc)
+         opt.jobs = strtoul(argv[++i],nullptr,10);
+      else if(arg=="--ordered")
+         opt.ordered = true;
+      else if(arg=="--max-open" && i+1<argc)
+         opt.max_open = strtoul(argv[++i],nullptr,10);
+      else if(arg=="--backend" && i+1<argc)
+         opt.backend = argv[++i];
+      else if(arg=="--queue-depth" && i+1<argc)
+         opt.queue_depth = strtoul(argv[++i],nullptr,10);
+      else if(arg=="--brief")
+         opt.brief = true;
+      else if(arg=="--stats")
+         opt.stats = true;
+      else if(arg=="--summarize")
+         opt.summarize = true;
+      else if(arg=="--top" && i+1<argc)
+         opt.top = strtoul(argv[++i],nullptr,10);
+      else if(arg=="--snapshot" && i+1<argc)
+         opt.snapshot = argv[++i];
+      else if(arg=="--watch")
+         opt.watch = true;
+      else if(arg=="--window" && i+1<argc)
+         opt.window = strtoul(argv[++i],nullptr,10);
+      else if(arg=="--duplicates")
+         opt.duplicates = true;
+      else if((arg=="--type" || arg=="--size" || arg=="--mtime" || arg=="--perm" || arg=="--name") && i+1<argc) {
+         if(!query::parse(arg.substr(2),argv[++i],opt.filter))
+            return false;
+         opt.query = true;
+      }
+      else if(arg=="--sort" && i+1<argc) {
+         const string o{argv[++i]};
+         if(o=="size")
+            opt.order = query::order::size;
+         else if(o=="mtime")
+            opt.order = query::order::mtime;
+         else if(o=="name")
+            opt.order = query::order::name;
+         else
+            return false;
+         opt.query = true;
+      }
+      else if(arg=="--limit" && i+1<argc) {
+         opt.limit = strtoul(argv[++i],nullptr,10);
+         opt.query = true;
+      }
+      else if(arg=="--memory" && i+1<argc) {
+         opt.memory = strtoul(argv[++i],nullptr,10);
+         opt.query = true;
+      }
+      else if(arg=="--format" && i+1<argc) {
+         const string f{argv[++i]};
+         if(f=="text")
+            opt.format = out::format::text;
+         else if(f=="null")
+            opt.format = out::format::null;
+         else if(f=="binary")
+            opt.format = out::format::binary;
+         else
+            return false;
+      }
+      else if(!has_path && arg.rfind("--",0)!=0) {
+         opt.path = arg;
+         has_path = true;
+      }
+      else
+         return false;
+   }
+   if(opt.backend!="std" && opt.backend!="dirent" && opt.backend!="uring")
+      return false;
+   const bool dirent = opt.backend!="std";
+   if(dirent && opt.jobs)
+      return false;
+   if(opt.brief && opt.backend!="dirent")
+      return false;
+   if(opt.stats && !dirent && opt.snapshot.empty() && !opt.duplicates && !opt.query)
+      return false;
+   if(!opt.snapshot.empty() && (dirent || opt.jobs || opt.summarize))
+      return false;
+   if(opt.watch && (dirent || opt.jobs || opt.summarize || !opt.snapshot.empty()))
+      return false;
+   if(opt.summarize && (dirent || opt.ordered))
+      return false;
+   if(opt.duplicates && (dirent || opt.ordered || opt.summarize || opt.watch || !opt.snapshot.empty()))
+      return false;
+   if(opt.query && (dirent || opt.jobs || opt.summarize || opt.watch || opt.duplicates || !opt.snapshot.empty()))
+      return false;
+   return has_path;
 }
 
-string fs_size(uintmax_t s)
+void summarize(const options& opt)
 {
-   ostringstream oss;
-   if(1'000'000'000 <= s)
-      oss << s/1'000'000'000 << 'G';
-   else if(1'000'000 <= s)
-      oss << s/1'000'000 << 'M';
-   else if(1'000 <= s)
-      oss << s/1'000 << 'K';
-   else
-      oss << s << 'B';
-   return oss.str();
-}
-
-using fs_entity = pair<fs::path,fs::file_status>;
+   const auto jobs = opt.jobs? opt.jobs : max(1u,thread::hardware_concurrency());
+   du::summarizer s{jobs,opt.top};
+   const auto [top,total] = s.run(opt.path.string());
 
-void display(const fs_entity& e)
-{
-   const auto& [path,status] = e;
-   cout  << fs_type(status.type())
-         << fs_rwx(status.permissions()) << " "
-         << setw(4) << right
-         << fs_size(fs::file_size(path)) << " "
-         << path 
-         << endl; 
+   const auto print = [](const du::usage& u) {
+      char size[24];
+      cout  << setw(5) << right << string(size,fs_size(u.bytes,size)) << " "
+            << setw(10) << u.files << " "
+            << quoted(u.path) << endl;
+   };
+   for(const auto& u: top)
+      print(u);
+   cout << "total:" << endl;
+   print(total);
+   if(s.failed())
+      throw runtime_error{"the total misses what could not be read, failures: " + to_string(s.failed())};
 }
 
-void fs_process(const fs_entity& e)
+void duplicates(const options& opt)
 {
-   const auto& [path,status] = e;
-
-   if(status.type()==fs::file_type::not_found) {
-      cout << path << " does not exist" << endl;
-      return;
-   }
-
-   display(e);
-   if(status.type()==fs::file_type::directory) {
-      for(const auto& i: fs::directory_iterator{path})
-         fs_process({i,i.status()});
-      return;
+   dupes::finder f{opt.jobs? opt.jobs : max(1u,thread::hardware_concurrency())};
+   f.scan(opt.path);
+   for(const auto& group: f.run()) {
+      char size[24];
+      cout << string(size,fs_size(group.front()->size,size)) << " x" << group.size() << endl;
+      for(const auto* file: group)
+         cout << "   " << quoted(file->path) << endl;
    }
-}
-
-void fs_process(const fs::path& p)
-{
-   fs_process({p,fs::status(p)});
+   if(opt.stats)
+      cerr << f.stats() << endl;
 }
 
 int main(int argc, char *argv[])
 {
-   if(argc != 2) {
-      cout << "Usage: " << argv[0] << " <path>" << endl;
+   options opt;
+   if(!parse(argc,argv,opt)) {
+      cout  << "Usage: " << argv[0] << " [--format text|null|binary] [--max-open N] <path>" << endl
+            << "       " << argv[0] << " [--format text|null|binary] --jobs N [--ordered] <path>" << endl
+            << "       " << argv[0] << " [--format text|null|binary] --backend dirent [--max-open N] [--brief] [--stats] <path>" << endl
+            << "       " << argv[0] << " [--format text|null|binary] --backend uring [--max-open N] [--queue-depth N] [--stats] <path>" << endl
+            << "       " << argv[0] << " --summarize [--jobs N] [--top N] <path>" << endl
+            << "       " << argv[0] << " [--format text|null|binary] --snapshot <file> [--stats] <path>" << endl
+            << "       " << argv[0] << " [--format text|null|binary] --watch [--window ms] <path>" << endl
+            << "       " << argv[0] << " --duplicates [--jobs N] [--stats] <path>" << endl
+            << "       " << argv[0] << " [--format text|null|binary] [--type f,d,l,b,c,p,s] [--size +N|-N[KMGT]] [--mtime +N|-N[smhd]] [--perm octal] [--name glob]" << endl
+            << "       " << string(strlen(argv[0]),' ') << " [--sort size|mtime|name] [--limit N] [--memory MiB] [--stats] <path>" << endl;
       return 1;
    }
 
+   out::writer w{STDOUT_FILENO,opt.format};
    try {
-      fs_process(argv[1]);
+      if(opt.summarize)
+         summarize(opt);
+      else if(opt.duplicates)
+         duplicates(opt);
+      else if(opt.query) {
+         query::finder f{w,opt.filter,opt.order,opt.limit,opt.memory<<20};
+         f.run(opt.path.string());
+         w.flush();
+         if(opt.stats)
+            cerr << f.stats() << endl;
+      }
+      else if(opt.watch)
+         watch::run(w,opt.path,chrono::milliseconds(opt.window));
+      else if(!opt.snapshot.empty()) {
+         const snapshot::image old{opt.snapshot};
+         snapshot::scanner s{w,old};
+         s.run(opt.path.string());
+         w.flush();
+         s.save(opt.snapshot);
+         if(opt.stats)
+            cerr << s.stats() << endl;
+      }
+      else if(opt.backend=="uring" && uring_::available()) {
+         const auto c = fs_process_uring(w,opt.path,opt.max_open,opt.queue_depth);
+         w.flush();
+         if(opt.stats)
+            cerr << c << endl;
+      }
+      else if(opt.backend!="std") {
+         if(opt.backend=="uring")
+            cerr << "io_uring is not available, falling back to the dirent backend" << endl;
+         const auto c = fs_process_dirent(w,opt.path,opt.brief,opt.max_open);
+         w.flush();
+         if(opt.stats)
+            cerr << c << endl;
+      }
+      else if(opt.jobs)
+         fs_process(w,opt.path,opt.jobs,opt.ordered);
+      else
+         fs_process(w,{opt.path,fs::status(opt.path)},opt.max_open);
+      w.flush();
    }
    catch(const exception& e) {
+      try {
+         w.flush();
+      }
+      catch(...) {}   // the error may be the output itself, e.g. a closed pipe
       cout << e.what() << endl;
       return 2;
    }
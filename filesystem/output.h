@@ -0,0 +1,276 @@
+#ifndef FS_OUTPUT_H_
+#define FS_OUTPUT_H_
+
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <string>
+#include <string_view>
+#include <system_error>
+
+#include <unistd.h>
+
+/**
+   Formatting layer of the listing.
+   Records are formatted by hand straight into one reusable byte buffer, which is written out by big blocks with write(2).
+   Neither a stream nor a temporary string is involved, so no allocation happens per entry once the buffer has been warmed up.
+
+   Besides the human readable 'text' format there are two formats for downstream tools:
+   - 'null'   : <type><rwx> <size in bytes> <path>'\0', the path is not quoted (type and path only for a brief listing);
+   - 'binary' : a fixed 16-byte 'record' (native byte order) followed by 'record::path_size' bytes of the path.
+
+   \see https://github.com/nikolaAV/Modern-Cpp/tree/master/filesystem
+*/
+
+namespace fs = std::filesystem;
+
+inline char fs_type(fs::file_type t) noexcept
+{
+   switch(t) {
+      case fs::file_type::regular   : return 'f';
+      case fs::file_type::directory : return 'd';
+      case fs::file_type::symlink   : return 'l';
+      case fs::file_type::block     : return 'b';
+      case fs::file_type::character : return 'c';
+      case fs::file_type::fifo      : return 'p';
+      case fs::file_type::socket    : return 's';
+
+      case fs::file_type::unknown   :
+      case fs::file_type::not_found :
+      case fs::file_type::none      :
+      default                       : break;
+   }
+   return '?';
+}
+
+/**
+   Writes 9 characters 'rwxrwxrwx' and returns the position past them.
+   fs::perms bits have the POSIX values, from owner_read (0400) down to others_exec (01).
+*/
+inline char* fs_rwx(fs::perms p, char* out) noexcept
+{
+   constexpr char rwx[] = "rwxrwxrwx";
+   const auto bits = static_cast<unsigned>(p);
+   for(unsigned i=0; i<9; ++i)
+      *out++ = (bits & (0400u>>i))? rwx[i] : '-';
+   return out;
+}
+
+inline char* fs_digits(std::uintmax_t v, char* out) noexcept
+{
+   char tmp[20];
+   char* p = tmp+sizeof(tmp);
+   do {
+      *--p = static_cast<char>('0' + v%10);
+      v /= 10;
+   } while(v);
+   const auto n = tmp+sizeof(tmp)-p;
+   std::memcpy(out,p,n);
+   return out+n;
+}
+
+inline char* fs_size(std::uintmax_t s, char* out) noexcept
+{
+   char unit{'B'};
+   if(1'000'000'000 <= s)
+      s /= 1'000'000'000, unit = 'G';
+   else if(1'000'000 <= s)
+      s /= 1'000'000, unit = 'M';
+   else if(1'000 <= s)
+      s /= 1'000, unit = 'K';
+   out = fs_digits(s,out);
+   *out++ = unit;
+   return out;
+}
+
+namespace out
+{
+
+enum class format { text, null, binary };
+
+struct record
+{
+   std::uint8_t   type;       // fs_type() character, or operation of writer::change()
+   std::uint8_t   reserved;
+   std::uint16_t  perms;      // POSIX permission bits
+   std::uint32_t  path_size;
+   std::uint64_t  size;       // in bytes
+};
+static_assert(16==sizeof(record));
+
+class writer
+{
+public:
+   static constexpr std::size_t block_size{1<<20};
+
+   /**
+      \param 'fd' is a descriptor to write to, or -1 to keep the records in memory (see 'view' and 'clear')
+   */
+   explicit writer(int fd = -1, format f = format::text)
+      :  fd_(fd)
+        ,format_(f)
+   {
+      if(fd_>=0)
+         data_.reserve(block_size+4096);
+   }
+
+   ~writer()
+   {
+      try {
+         flush();
+      }
+      catch(...) {}
+   }
+
+   writer(const writer&) = delete;
+   writer& operator=(const writer&) = delete;
+
+   format mode() const noexcept { return format_; }
+
+   void entry(fs::file_type t, fs::perms p, std::uintmax_t size, std::string_view path)
+   {
+      if(format::binary==format_)
+         return binary(fs_type(t),p,size,path);
+
+      char line[40];
+      char* end = fs_rwx(p,line+1);
+      line[0] = fs_type(t);
+      *end++ = ' ';
+      if(format::text==format_) {
+         char s[24];
+         const auto n = fs_size(size,s)-s;
+         for(auto i=n; i<4; ++i)
+            *end++ = ' ';
+         std::memcpy(end,s,n);
+         end += n;
+      }
+      else
+         end = fs_digits(size,end);
+      *end++ = ' ';
+      data_.append(line,end-line);
+      path_field(path);
+      commit();
+   }
+
+   /**
+      Type and path only, e.g. when 'd_type' is all a walker knows.
+   */
+   void brief(fs::file_type t, std::string_view path)
+   {
+      if(format::binary==format_)
+         return binary(fs_type(t),fs::perms::none,0,path);
+      data_ += fs_type(t);
+      data_ += ' ';
+      path_field(path);
+      commit();
+   }
+
+   void missing(std::string_view path)
+   {
+      if(format::text!=format_)
+         return brief(fs::file_type::not_found,path);
+      quoted(path);
+      data_.append(" does not exist\n");
+      commit();
+   }
+
+   /**
+      One line of a difference between two states of a tree: '+' added, '-' removed, 'M' modified.
+   */
+   void change(char op, std::string_view path)
+   {
+      if(format::binary==format_)
+         return binary(op,fs::perms::none,0,path);
+      data_ += op;
+      data_ += ' ';
+      path_field(path);
+      commit();
+   }
+
+   /**
+      Appends already formatted records, e.g. kept by another writer in memory.
+   */
+   void append(std::string_view s)
+   {
+      data_.append(s);
+      commit();
+   }
+
+   std::string_view view() const noexcept { return data_; }
+   void clear() noexcept { data_.clear(); }
+
+   void flush()
+   {
+      if(fd_<0)
+         return;
+      for(std::size_t done=0; done<data_.size();) {
+         const auto n = ::write(fd_,data_.data()+done,data_.size()-done);
+         if(n<0) {
+            if(EINTR==errno)
+               continue;
+            data_.clear();
+            throw std::system_error{errno,std::generic_category(),"write"};
+         }
+         done += n;
+      }
+      data_.clear();
+   }
+
+private:
+   void commit()
+   {
+      if(fd_>=0 && data_.size()>=block_size)
+         flush();
+   }
+
+   void path_field(std::string_view path)
+   {
+      if(format::text==format_) {
+         quoted(path);
+         data_ += '\n';
+      }
+      else {
+         data_.append(path);
+         data_ += '\0';
+      }
+   }
+
+   /**
+      The same escaping as std::quoted, i.e. operator<< for fs::path.
+   */
+   void quoted(std::string_view s)
+   {
+      data_ += '"';
+      for(auto pos = s.find_first_of("\"\\"); std::string_view::npos!=pos; pos = s.find_first_of("\"\\")) {
+         data_.append(s.substr(0,pos));
+         data_ += '\\';
+         data_ += s[pos];
+         s.remove_prefix(pos+1);
+      }
+      data_.append(s);
+      data_ += '"';
+   }
+
+   void binary(char type, fs::perms p, std::uintmax_t size, std::string_view path)
+   {
+      const record r{
+          static_cast<std::uint8_t>(type)
+         ,0
+         ,static_cast<std::uint16_t>(static_cast<unsigned>(p) & 07777)
+         ,static_cast<std::uint32_t>(path.size())
+         ,static_cast<std::uint64_t>(size)
+      };
+      data_.append(reinterpret_cast<const char*>(&r),sizeof(r));
+      data_.append(path);
+      commit();
+   }
+
+   const int      fd_;
+   const format   format_;
+   std::string    data_;
+};
+
+}  // end of namespace out
+
+#endif // FS_OUTPUT_H_
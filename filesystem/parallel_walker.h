@@ -0,0 +1,186 @@
+#ifndef FS_PARALLEL_WALKER_H_
+#define FS_PARALLEL_WALKER_H_
+
+#include "listing.h"
+#include "work_stealing.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/**
+   Parallel counterpart of 'fs_process'.
+   A work-stealing pool of walker threads lists directories, so stat latency of one directory is overlapped with the listing of the others.
+
+   Directories are completed in any order. In the 'ordered' mode every listing is kept in a 'dir_node'
+   and the caller thread merges them back in the very same order as the recursive 'fs_process' prints,
+   releasing every node as soon as it has been written out.
+
+   \see https://github.com/nikolaAV/Modern-Cpp/tree/master/filesystem
+*/
+
+namespace parallel
+{
+
+struct dir_node
+{
+   struct segment
+   {
+      std::string                text;    // lines up to and including a subdirectory
+      std::unique_ptr<dir_node>  child;   // listing of that subdirectory, if any
+   };
+
+   std::vector<segment> segments;
+   std::atomic<bool>    ready{false};
+};
+
+class walker
+{
+public:
+   walker(out::writer& os, std::size_t jobs, bool ordered)
+      :  os_(os)
+        ,pool_(jobs)
+        ,ordered_(ordered)
+   {}
+
+   walker(const walker&) = delete;
+   walker& operator=(const walker&) = delete;
+
+   void run(const fs_entity& e)
+   {
+      if(!fs_visit(os_,e))
+         return;
+
+      std::unique_ptr<dir_node> root{ordered_? new dir_node : nullptr};
+      pool_.push(0,{e.first,root.get()});
+
+      std::vector<std::thread> threads;
+      for(std::size_t i=1; i<pool_.size(); ++i)
+         threads.emplace_back([this,i]{ work(i); });
+      if(ordered_)
+         threads.emplace_back([this]{ work(0); });
+
+      if(ordered_)
+         merge(*root);
+      else
+         work(0);
+
+      for(auto& t: threads)
+         t.join();
+      if(error_)
+         std::rethrow_exception(error_);
+   }
+
+private:
+   struct task
+   {
+      fs::path    path;
+      dir_node*   node{nullptr};   // nullptr in the unordered mode
+   };
+
+   void work(std::size_t self)
+   {
+      pool_.work(self,[this](std::size_t self, const task& t) {
+         if(!stop_.load(std::memory_order_relaxed))
+            try {
+               list(self,t);
+            }
+            catch(...) {
+               fail(std::current_exception());
+            }
+         if(t.node)
+            complete(*t.node);
+      });
+   }
+
+   void list(std::size_t self, const task& t)
+   {
+      out::writer block{-1,os_.mode()};
+      for(const auto& i: fs::directory_iterator{t.path}) {
+         if(!fs_visit(block,{i,i.status()}))
+            continue;
+         dir_node* child{nullptr};
+         if(t.node) {
+            t.node->segments.push_back({std::string{block.view()},std::make_unique<dir_node>()});
+            child = t.node->segments.back().child.get();
+            block.clear();
+         }
+         pool_.push(self,{i.path(),child});
+      }
+      if(t.node)
+         t.node->segments.push_back({std::string{block.view()},nullptr});
+      else {
+         std::lock_guard lock{output_};
+         os_.append(block.view());
+      }
+   }
+
+   void complete(dir_node& n)
+   {
+      {  std::lock_guard lock{output_};
+         n.ready.store(true,std::memory_order_release);
+      }
+      done_.notify_one();
+   }
+
+   void fail(std::exception_ptr e)
+   {
+      std::lock_guard lock{output_};
+      if(!error_)
+         error_ = e;
+      stop_.store(true,std::memory_order_relaxed);
+   }
+
+   /**
+      Ordered-merge stage: pre-order traversal over the nodes, waiting for each one to be listed.
+   */
+   void merge(dir_node& root)
+   {
+      struct frame { dir_node* node; std::size_t next; };
+      std::vector<frame> stack{{&root,0}};
+      while(!stack.empty()) {
+         auto& [node,next] = stack.back();
+         if(0==next) {
+            std::unique_lock lock{output_};
+            done_.wait(lock,[node=node]{ return node->ready.load(std::memory_order_acquire); });
+         }
+         if(next==node->segments.size()) {
+            stack.pop_back();
+            if(!stack.empty()) {
+               auto& parent = stack.back();
+               parent.node->segments[parent.next-1].child.reset();
+            }
+            continue;
+         }
+         auto& s = node->segments[next++];
+         os_.append(s.text);
+         if(s.child)
+            stack.push_back({s.child.get(),0});
+      }
+   }
+
+   out::writer&                  os_;
+   work_stealing_pool<task>      pool_;
+   const bool                    ordered_;
+   std::atomic<bool>             stop_{false};
+   std::mutex                    output_;
+   std::condition_variable       done_;
+   std::exception_ptr            error_;
+};
+
+}  // end of namespace parallel
+
+/**
+   \param 'jobs' is a number of walker threads
+   \param 'ordered' keeps the output identical to the sequential 'fs_process'
+*/
+inline void fs_process(out::writer& os, const fs::path& p, std::size_t jobs, bool ordered)
+{
+   parallel::walker{os,jobs,ordered}.run({p,fs::status(p)});
+}
+
+#endif // FS_PARALLEL_WALKER_H_
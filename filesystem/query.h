@@ -0,0 +1,514 @@
+#ifndef FS_QUERY_H_
+#define FS_QUERY_H_
+
+#include "dirent_walker.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <ostream>
+#include <queue>
+#include <string>
+#include <system_error>
+#include <vector>
+
+#include <fnmatch.h>
+
+/**
+   Filtered and sorted listing: "files larger than 1 GiB modified in the last day, sorted by size".
+
+   Predicates are pushed down the walk, so that every entry costs as little as possible:
+   - the name glob and the type given by 'd_type' are checked on the getdents64 buffer, before any stat;
+   - a single statx (with only the fields in the mask the predicates need) answers size, mtime and permissions;
+   - only matching entries are formatted at all.
+   Subdirectories are descended whether they match or not. Symbolic links are not followed, like 'find' does.
+
+   Sorting keeps the matches in memory as long as they fit into a budget, otherwise sorted runs are spilled into temporary files
+   and merged at the end (external merge sort). With a limit, only the best 'limit' matches are kept in a bounded heap (streaming top-K).
+
+   \see https://man7.org/linux/man-pages/man1/find.1.html
+*/
+
+namespace query
+{
+
+struct filter
+{
+   unsigned       types{0};            // bit mask of fs::file_type, 0 is any type
+   std::uint64_t  min_size{0};         // bytes, inclusive
+   std::uint64_t  max_size{~0ull};
+   std::int64_t   newer{INT64_MIN};    // mtime in nanoseconds since the epoch, exclusive
+   std::int64_t   older{INT64_MAX};
+   unsigned       perms{0};            // all these bits are required
+   std::string    name;                // glob of the name
+
+   static constexpr unsigned bit(fs::file_type t) noexcept { return 1u<<static_cast<int>(t); }
+
+   bool by_type(fs::file_type t) const noexcept { return !types || (types & bit(t)); }
+   bool by_name(const char* n) const noexcept { return name.empty() || 0==::fnmatch(name.c_str(),n,0); }
+
+   /**
+      \retval the statx fields the predicates and the output need
+   */
+   unsigned mask() const noexcept
+   {
+      unsigned m = STATX_TYPE|STATX_MODE|STATX_SIZE;
+      if(INT64_MIN!=newer || INT64_MAX!=older)
+         m |= STATX_MTIME;
+      return m;
+   }
+
+   bool by_stat(std::uint64_t size, std::int64_t mtime, unsigned mode) const noexcept
+   {
+      return min_size<=size && size<=max_size && newer<mtime && mtime<older && (mode & perms)==perms;
+   }
+};
+
+enum class order { none, size, mtime, name };
+
+struct match
+{
+   std::uint64_t  key;     // size or mtime, see 'order'
+   fs::file_type  type;
+   fs::perms      perms;
+   std::uint64_t  size;
+   std::string    path;
+};
+
+/**
+   Strict ordering of matches: the largest size or the newest mtime first, by path otherwise.
+*/
+struct before
+{
+   order o;
+
+   bool operator()(const match& a, const match& b) const noexcept
+   {
+      if(order::name!=o && a.key!=b.key)
+         return a.key>b.key;
+      return a.path<b.path;
+   }
+};
+
+class sorter
+{
+public:
+   static constexpr std::size_t max_runs{64};   // merged into one when reached
+
+   /**
+      \param 'limit' keeps only the first 'limit' matches, 0 is all of them
+      \param 'budget' is the memory (bytes) of matches kept before a sorted run is spilled
+   */
+   sorter(order o, std::size_t limit, std::size_t budget)
+      :  before_{o}
+        ,limit_(limit)
+        ,budget_(budget)
+        ,heap_(before_)
+   {}
+
+   ~sorter()
+   {
+      for(auto* f: runs_)
+         std::fclose(f);
+   }
+
+   sorter(const sorter&) = delete;
+   sorter& operator=(const sorter&) = delete;
+
+   void push(match m)
+   {
+      if(limit_) {
+         if(heap_.size()<limit_)
+            heap_.push(std::move(m));
+         else if(before_(m,heap_.top())) {
+            heap_.pop();
+            heap_.push(std::move(m));
+         }
+         return;
+      }
+      memory_ += sizeof(match)+m.path.size();
+      matches_.push_back(std::move(m));
+      if(memory_>budget_)
+         spill();
+   }
+
+   std::size_t runs() const noexcept { return runs_.size(); }
+
+   /**
+      Writes the matches in order.
+   */
+   void emit(out::writer& w)
+   {
+      if(limit_) {
+         for(; !heap_.empty(); heap_.pop())
+            matches_.push_back(heap_.top());
+         std::reverse(matches_.begin(),matches_.end());
+      }
+      else if(!runs_.empty()) {
+         spill();
+         merge([&w](const match& m){ print(w,m); });
+         return;
+      }
+      else
+         std::sort(matches_.begin(),matches_.end(),before_);
+      for(const auto& m: matches_)
+         print(w,m);
+      matches_.clear();
+   }
+
+private:
+   static void print(out::writer& w, const match& m)
+   {
+      w.entry(m.type,m.perms,m.size,m.path);
+   }
+
+   void spill()
+   {
+      std::sort(matches_.begin(),matches_.end(),before_);
+      auto* f = temporary();
+      runs_.push_back(f);
+      for(const auto& m: matches_)
+         write(f,m);
+      rewind(f);
+      matches_.clear();
+      memory_ = 0;
+      if(runs_.size()>=max_runs)
+         compact();
+   }
+
+   static std::FILE* temporary()
+   {
+      auto* f = std::tmpfile();
+      if(!f)
+         throw std::system_error{errno,std::generic_category(),"cannot create a temporary file"};
+      return f;
+   }
+
+   static void write(std::FILE* f, const match& m)
+   {
+      const std::uint64_t head[] = {m.key,static_cast<std::uint64_t>(m.type),static_cast<std::uint64_t>(m.perms),m.size,m.path.size()};
+      std::fwrite(head,sizeof(head),1,f);
+      std::fwrite(m.path.data(),1,m.path.size(),f);
+   }
+
+   static void rewind(std::FILE* f)
+   {
+      if(std::fflush(f) || std::fseek(f,0,SEEK_SET) || std::ferror(f))
+         throw std::system_error{errno,std::generic_category(),"cannot write a temporary file"};
+   }
+
+   static bool read(std::FILE* f, match& m)
+   {
+      std::uint64_t head[5];
+      if(1!=std::fread(head,sizeof(head),1,f))
+         return false;
+      m.key = head[0];
+      m.type = static_cast<fs::file_type>(head[1]);
+      m.perms = static_cast<fs::perms>(head[2]);
+      m.size = head[3];
+      m.path.resize(head[4]);
+      return m.path.size()==std::fread(m.path.data(),1,m.path.size(),f);
+   }
+
+   /**
+      k-way merge of the sorted runs, one match of every run in memory.
+   */
+   template <typename Sink>
+   void merge(Sink sink)
+   {
+      std::vector<match> heads(runs_.size());
+      const auto after = [this,&heads](std::size_t a, std::size_t b){ return before_(heads[b],heads[a]); };
+      std::priority_queue<std::size_t,std::vector<std::size_t>,decltype(after)> q{after};
+      for(std::size_t i=0; i<runs_.size(); ++i)
+         if(read(runs_[i],heads[i]))
+            q.push(i);
+      while(!q.empty()) {
+         const auto i = q.top();
+         q.pop();
+         sink(heads[i]);
+         if(read(runs_[i],heads[i]))
+            q.push(i);
+      }
+   }
+
+   /**
+      Merges all runs into a single one, so that the number of open files stays bounded.
+   */
+   void compact()
+   {
+      auto* f = temporary();
+      merge([f](const match& m){ write(f,m); });
+      rewind(f);
+      for(auto* r: runs_)
+         std::fclose(r);
+      runs_.assign(1,f);
+   }
+
+   using heap = std::priority_queue<match,std::vector<match>,before>;
+
+   before                  before_;
+   const std::size_t       limit_;
+   const std::size_t       budget_;
+   heap                    heap_;      // top-K, the worst kept one on the top
+   std::vector<match>      matches_;
+   std::size_t             memory_{0};
+   std::vector<std::FILE*> runs_;
+};
+
+struct counters
+{
+   std::uint64_t entries{0};
+   std::uint64_t statx{0};
+   std::uint64_t matched{0};
+   std::uint64_t runs{0};     // spilled by the external sort and not merged yet
+};
+
+inline std::ostream& operator<<(std::ostream& os, const counters& c)
+{
+   os    << "entries: " << c.entries
+         << ", statx: " << c.statx
+         << ", matched: " << c.matched
+         << ", sorted runs spilled: " << c.runs;
+   return os;
+}
+
+/**
+   Walks the tree 'path' and writes the matching entries, sorted by 'o'.
+   Without an order matches are written as they are found, a limit then stops the walk as soon as it is reached.
+*/
+class finder
+{
+public:
+   finder(out::writer& w, const filter& f, order o, std::size_t limit, std::size_t budget)
+      :  w_(w)
+        ,f_(f)
+        ,o_(o)
+        ,limit_(limit)
+        ,sorter_(o,limit,budget)
+   {}
+
+   void run(const std::string& path)
+   {
+      std::string name = fs::path{path}.filename().string();
+      if(name.empty())
+         name = path;
+      struct statx st;
+      if(!stat(AT_FDCWD,path.c_str(),path,st))
+         dirent_::fail("cannot get file status",path);
+      const auto type = dirent_::from_mode(st.stx_mode);
+      examine(path,name.c_str(),type,st);
+
+      std::vector<std::string> stack;
+      if(fs::file_type::directory==type)
+         stack.push_back(path);
+      std::vector<char> buffer(dirent_::walker::buffer_size);
+      while(!stack.empty() && !done()) {
+         const auto dir = std::move(stack.back());
+         stack.pop_back();
+         list(dir,buffer,stack);
+      }
+      c_.runs = sorter_.runs();
+      if(order::none!=o_)
+         sorter_.emit(w_);
+   }
+
+   const counters& stats() const noexcept { return c_; }
+
+private:
+   void list(const std::string& dir, std::vector<char>& buffer, std::vector<std::string>& stack)
+   {
+      const int fd = ::open(dir.c_str(),O_RDONLY|O_DIRECTORY|O_CLOEXEC);
+      if(fd<0)
+         dirent_::fail("cannot open directory",dir);
+      struct closer { int fd; ~closer() { ::close(fd); } } guard{fd};   // on an exception too
+      std::string path{dir};
+      if(path.empty() || '/'!=path.back())
+         path += '/';
+      const auto length = path.size();
+
+      while(!done()) {
+         const auto size = ::syscall(SYS_getdents64,fd,buffer.data(),buffer.size());
+         if(size<0)
+            dirent_::fail("cannot read directory",dir);
+         if(0==size)
+            break;
+         for(long pos=0; pos<size && !done();) {
+            const auto* d = reinterpret_cast<const dirent_::linux_dirent64*>(buffer.data()+pos);
+            pos += d->d_reclen;
+            if(dirent_::is_dot(d->d_name))
+               continue;
+            ++c_.entries;
+            path.resize(length);
+            path += d->d_name;
+
+            // pushdown: name and d_type first, a rejected entry costs no stat unless it has to be descended
+            auto type = dirent_::from_dtype(d->d_type);
+            const bool known = fs::file_type::unknown!=type;
+            const bool wanted = f_.by_name(d->d_name) && (!known || f_.by_type(type));
+            if(!wanted && known) {
+               if(fs::file_type::directory==type)
+                  stack.push_back(path);
+               continue;
+            }
+            struct statx st;
+            if(!stat(fd,d->d_name,path,st))
+               continue;
+            type = dirent_::from_mode(st.stx_mode);
+            if(wanted)
+               examine(path,d->d_name,type,st);
+            if(fs::file_type::directory==type)
+               stack.push_back(path);
+         }
+      }
+   }
+
+   void examine(const std::string& path, const char* name, fs::file_type type, const struct statx& st)
+   {
+      const std::uint64_t size = fs::file_type::regular==type? st.stx_size : 0;
+      const auto mtime = std::int64_t{st.stx_mtime.tv_sec}*1'000'000'000 + st.stx_mtime.tv_nsec;
+      if(!f_.by_name(name) || !f_.by_type(type) || !f_.by_stat(size,mtime,st.stx_mode & 07777))
+         return;
+      ++c_.matched;
+      const auto perms = fs::perms(st.stx_mode & 07777);
+      if(order::none==o_)
+         w_.entry(type,perms,size,path);
+      else
+         sorter_.push({order::mtime==o_? static_cast<std::uint64_t>(mtime) : size,type,perms,size,path});
+   }
+
+   /**
+      A vanished entry is skipped, any other error is thrown with the 'path' of the entry 'name' relative to 'at'.
+   */
+   bool stat(int at, const char* name, const std::string& path, struct statx& st)
+   {
+      ++c_.statx;
+      if(0==::statx(at,name,AT_SYMLINK_NOFOLLOW|AT_STATX_DONT_SYNC,f_.mask(),&st))
+         return true;
+      if(ENOENT!=errno)
+         dirent_::fail("cannot get file status",path);
+      return false;
+   }
+
+   bool done() const noexcept { return order::none==o_ && limit_ && c_.matched>=limit_; }
+
+   out::writer&   w_;
+   const filter&  f_;
+   const order    o_;
+   const std::size_t limit_;
+   sorter         sorter_;
+   counters       c_;
+};
+
+/**
+   Parses a size like "1G" (binary units K, M, G, T).
+   \retval false on a malformed one
+*/
+inline bool parse_size(const std::string& s, std::uint64_t& bytes)
+{
+   char* end{nullptr};
+   bytes = std::strtoull(s.c_str(),&end,10);
+   if(end==s.c_str())
+      return false;
+   const std::string unit{end};
+   const std::string units{"BKMGT"};
+   if(unit.empty())
+      return true;
+   const auto i = units.find(unit);
+   if(1!=unit.size() || std::string::npos==i)
+      return false;
+   bytes <<= 10*i;
+   return true;
+}
+
+/**
+   Parses an age like "30m" (units s, m, h, d).
+   \retval false on a malformed one
+*/
+inline bool parse_age(const std::string& s, std::chrono::seconds& age)
+{
+   char* end{nullptr};
+   const auto n = std::strtoll(s.c_str(),&end,10);
+   if(end==s.c_str())
+      return false;
+   const std::string unit{end};
+   if(unit.empty() || unit=="s")
+      age = std::chrono::seconds{n};
+   else if(unit=="m")
+      age = std::chrono::minutes{n};
+   else if(unit=="h")
+      age = std::chrono::hours{n};
+   else if(unit=="d")
+      age = std::chrono::hours{24*n};
+   else
+      return false;
+   return true;
+}
+
+/**
+   Adds a predicate given like 'find' does:
+      type  "f,d,l"  (f d l b c p s)
+      size  "+1G" larger than, "-10M" smaller than
+      mtime "-1d" modified within, "+7d" modified before
+      perm  "0644"   all these bits set
+      name  "*.log"
+   \retval false on a malformed one
+*/
+inline bool parse(const std::string& what, const std::string& value, filter& f)
+{
+   if(what=="type") {
+      for(const char c: value) {
+         const std::string letters{"fdlbcps"};
+         static constexpr fs::file_type types[] = {fs::file_type::regular,fs::file_type::directory,fs::file_type::symlink,
+            fs::file_type::block,fs::file_type::character,fs::file_type::fifo,fs::file_type::socket};
+         const auto i = letters.find(c);
+         if(std::string::npos!=i)
+            f.types |= filter::bit(types[i]);
+         else if(','!=c)
+            return false;
+      }
+      return 0!=f.types;
+   }
+   if(what=="name") {
+      f.name = value;
+      return !value.empty();
+   }
+   if(what=="perm") {
+      char* end{nullptr};
+      f.perms = std::strtoul(value.c_str(),&end,8) & 07777;
+      return !value.empty() && '\0'==*end;
+   }
+   if(value.size()<2 || ('+'!=value[0] && '-'!=value[0]))
+      return false;
+   const bool more = '+'==value[0];
+   if(what=="size") {
+      std::uint64_t bytes;
+      if(!parse_size(value.substr(1),bytes))
+         return false;
+      if(more)
+         f.min_size = bytes+1;
+      else if(0==bytes)   // smaller than nothing
+         return false;
+      else
+         f.max_size = bytes-1;
+      return true;
+   }
+   if(what=="mtime") {
+      std::chrono::seconds age;
+      if(!parse_age(value.substr(1),age))
+         return false;
+      const auto now = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::system_clock::now().time_since_epoch());
+      const auto at = (now-age).count();
+      if(more)
+         f.older = at;
+      else
+         f.newer = at;
+      return true;
+   }
+   return false;
+}
+
+}  // end of namespace query
+
+#endif // FS_QUERY_H_
@@ -0,0 +1,370 @@
+#ifndef FS_SNAPSHOT_H_
+#define FS_SNAPSHOT_H_
+
+#include "dirent_walker.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <fstream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <sys/mman.h>
+
+/**
+   Persistent snapshot of a tree and incremental rescan against it.
+
+   The snapshot file is
+      header | record[header.records] | string table of names (header.names bytes)
+   Records are stored breadth first, i.e. sorted by (parent, name): the children of every directory are contiguous
+   and sorted by name, record 0 is the root and its name is the path the snapshot was taken of.
+   The previous snapshot is memory mapped read-only and validated once by a linear scan of its records, nothing of it is copied.
+
+   A rescan relies on the fact that creating, removing or renaming an entry updates the mtime of its directory:
+   - a directory with the same mtime is not read at all, its children are taken from the snapshot
+     (only subdirectories are stat-ed to be checked in turn);
+   - a changed directory is read and merged with the sorted children from the snapshot, which gives added, removed and modified entries.
+   So content changes of files are detected in changed directories only, the price of not stat-ing every file.
+   Symbolic links are not followed.
+*/
+
+namespace snapshot
+{
+
+struct header
+{
+   char           magic[8];
+   std::uint64_t  records;
+   std::uint64_t  names;
+};
+
+struct record
+{
+   std::uint64_t  name;          // offset in the string table
+   std::uint32_t  name_size;
+   std::uint32_t  mode;          // type and permissions
+   std::int64_t   mtime;         // nanoseconds
+   std::uint64_t  size;
+   std::uint64_t  first_child;   // index of the first child
+   std::uint64_t  children;
+};
+
+constexpr char magic[8] = {'F','S','S','N','A','P','0','1'};
+constexpr std::uint64_t none = ~std::uint64_t{0};
+
+/**
+   Read-only view of a snapshot file.
+*/
+class image
+{
+public:
+   explicit image(const std::string& file)
+   {
+      const int fd = ::open(file.c_str(),O_RDONLY|O_CLOEXEC);
+      if(fd<0)
+         return;
+      struct stat st;
+      if(0==::fstat(fd,&st) && std::size_t(st.st_size)>=sizeof(header)) {
+         void* p = ::mmap(nullptr,st.st_size,PROT_READ,MAP_PRIVATE,fd,0);
+         if(MAP_FAILED!=p) {
+            data_ = static_cast<const char*>(p);
+            size_ = st.st_size;
+         }
+      }
+      ::close(fd);
+      if(data_ && !valid())
+         unmap();
+   }
+
+   ~image() { unmap(); }
+
+   image(const image&) = delete;
+   image& operator=(const image&) = delete;
+
+   explicit operator bool() const noexcept { return nullptr!=data_; }
+
+   std::uint64_t size() const noexcept { return head().records; }
+   const record& operator[](std::uint64_t i) const noexcept { return records()[i]; }
+
+   std::string_view name(const record& r) const noexcept
+   {
+      return {data_+sizeof(header)+size()*sizeof(record)+r.name,r.name_size};
+   }
+
+private:
+   const header& head() const noexcept { return *reinterpret_cast<const header*>(data_); }
+   const record* records() const noexcept { return reinterpret_cast<const record*>(data_+sizeof(header)); }
+
+   bool valid() const noexcept
+   {
+      const auto& h = head();
+      if(0!=std::memcmp(h.magic,magic,sizeof(magic)) || 0==h.records)
+         return false;
+      if(h.records>(size_-sizeof(header))/sizeof(record) || sizeof(header)+h.records*sizeof(record)+h.names!=size_)
+         return false;
+      for(std::uint64_t i=0; i<h.records; ++i) {
+         const auto& r = records()[i];
+         if(r.name+r.name_size>h.names || (r.children && (r.first_child<=i || r.first_child+r.children>h.records)))
+            return false;
+      }
+      return true;
+   }
+
+   void unmap() noexcept
+   {
+      if(data_)
+         ::munmap(const_cast<char*>(data_),size_);
+      data_ = nullptr;
+   }
+
+   const char* data_{nullptr};
+   std::size_t size_{0};
+};
+
+struct counters
+{
+   std::uint64_t listed{0};      // directories read
+   std::uint64_t skipped{0};     // directories taken from the snapshot
+   std::uint64_t stats{0};
+   std::uint64_t added{0}, removed{0}, modified{0};
+};
+
+inline std::ostream& operator<<(std::ostream& os, const counters& c)
+{
+   os    << "directories listed: " << c.listed
+         << ", taken from snapshot: " << c.skipped
+         << ", statx: " << c.stats
+         << ", added: " << c.added
+         << ", removed: " << c.removed
+         << ", modified: " << c.modified;
+   return os;
+}
+
+class scanner
+{
+public:
+   scanner(out::writer& w, const image& old)
+      :  w_(w)
+        ,old_(old)
+   {}
+
+   /**
+      Scans 'path' and reports its difference against the old image.
+      The new state of the tree is kept to be saved.
+   */
+   void run(const std::string& path)
+   {
+      record root{};
+      if(!stat(AT_FDCWD,path.c_str(),root))
+         dirent_::fail("cannot get file status",path);
+      auto old = (old_ && old_.name(old_[0])==path)? std::uint64_t{0} : none;
+      if(none==old)
+         report('+',path,c_.added);
+      else
+         old = compare(old,root,path);
+      add(root,path,old);
+
+      std::deque<std::pair<std::uint64_t,std::string>> queue{{0,path}};   // directories to scan
+      while(!queue.empty()) {
+         const auto n = queue.front().first;
+         const auto dir = std::move(queue.front().second);
+         queue.pop_front();
+         if(!S_ISDIR(records_[n].mode))
+            continue;
+
+         const auto o = origins_[n];
+         records_[n].first_child = records_.size();
+         if(none!=o && old_[o].mtime==records_[n].mtime)
+            reuse(o,dir);
+         else
+            list(o,dir);
+         records_[n].children = records_.size()-records_[n].first_child;
+
+         for(auto i=records_[n].first_child; i<records_.size(); ++i)
+            if(S_ISDIR(records_[i].mode))
+               queue.emplace_back(i,join(dir,name(records_[i])));
+      }
+   }
+
+   /**
+      Writes the new state down to 'file' (through a temporary file, so a failure keeps the old one).
+   */
+   void save(const std::string& file) const
+   {
+      const auto tmp = file + ".tmp";
+      {
+         std::ofstream os{tmp,std::ios::binary|std::ios::trunc};
+         header h{};
+         std::memcpy(h.magic,magic,sizeof(magic));
+         h.records = records_.size();
+         h.names = names_.size();
+         os.write(reinterpret_cast<const char*>(&h),sizeof(h));
+         os.write(reinterpret_cast<const char*>(records_.data()),records_.size()*sizeof(record));
+         os.write(names_.data(),names_.size());
+         if(!os.flush())
+            throw fs::filesystem_error{"cannot write snapshot",tmp,std::make_error_code(std::errc::io_error)};
+      }
+      fs::rename(tmp,file);
+   }
+
+   const counters& stats() const noexcept { return c_; }
+
+private:
+   /**
+      The listing of the directory is the same as in the snapshot: copy the records,
+      only subdirectories are stat-ed to be checked in turn.
+   */
+   void reuse(std::uint64_t o, const std::string& dir)
+   {
+      ++c_.skipped;
+      const auto& od = old_[o];
+      for(auto i=od.first_child; i<od.first_child+od.children; ++i) {
+         auto r = old_[i];
+         if(S_ISDIR(r.mode)) {
+            const auto path = join(dir,old_.name(r));
+            if(!stat(AT_FDCWD,path.c_str(),r)) {
+               removed(i,path);
+               continue;
+            }
+            add(r,old_.name(old_[i]),compare(i,r,path));
+         }
+         else
+            add(r,old_.name(old_[i]),i);
+      }
+   }
+
+   void list(std::uint64_t o, const std::string& dir)
+   {
+      ++c_.listed;
+      const int fd = ::open(dir.c_str(),O_RDONLY|O_DIRECTORY|O_CLOEXEC);
+      if(fd<0)
+         dirent_::fail("cannot open directory",dir);
+
+      std::vector<std::pair<std::string,record>> entries;
+      std::vector<char> buffer(dirent_::walker::buffer_size);
+      for(;;) {
+         const auto size = ::syscall(SYS_getdents64,fd,buffer.data(),buffer.size());
+         if(size<0) {   // the unread entries would be reported as removed and missing from the saved snapshot
+            const int error = errno;
+            ::close(fd);
+            errno = error;
+            dirent_::fail("cannot read directory",dir);
+         }
+         if(0==size)
+            break;
+         for(long pos=0; pos<size;) {
+            const auto* d = reinterpret_cast<const dirent_::linux_dirent64*>(buffer.data()+pos);
+            pos += d->d_reclen;
+            if(dirent_::is_dot(d->d_name))
+               continue;
+            record r{};
+            if(stat(fd,d->d_name,r))
+               entries.emplace_back(d->d_name,r);
+         }
+      }
+      ::close(fd);
+      std::sort(entries.begin(),entries.end(),[](const auto& a, const auto& b){ return a.first<b.first; });
+
+      // merge-join with the old children, both are sorted by name
+      std::uint64_t i{0}, end{0};
+      if(none!=o)
+         i = old_[o].first_child, end = i+old_[o].children;
+      for(const auto& [entry,r]: entries) {
+         const auto path = join(dir,entry);
+         for(; i<end && old_.name(old_[i])<entry; ++i)
+            removed(i,join(dir,old_.name(old_[i])));
+         if(i<end && old_.name(old_[i])==entry) {
+            add(r,entry,compare(i,r,path));
+            ++i;
+            continue;
+         }
+         report('+',path,c_.added);
+         add(r,entry,none);
+      }
+      for(; i<end; ++i)
+         removed(i,join(dir,old_.name(old_[i])));
+   }
+
+   /**
+      \retval the old record to compare the children with, if any
+   */
+   std::uint64_t compare(std::uint64_t o, const record& n, const std::string& path)
+   {
+      const auto& r = old_[o];
+      if((r.mode & S_IFMT)!=(n.mode & S_IFMT)) {
+         removed(o,path);
+         report('+',path,c_.added);
+         return none;
+      }
+      if(!S_ISDIR(n.mode) && (r.mode!=n.mode || r.size!=n.size || r.mtime!=n.mtime))
+         report('M',path,c_.modified);
+      return o;
+   }
+
+   /**
+      Reports an old entry and its whole old subtree as removed.
+   */
+   void removed(std::uint64_t o, const std::string& path)
+   {
+      report('-',path,c_.removed);
+      const auto& r = old_[o];
+      for(auto i=r.first_child; i<r.first_child+r.children; ++i)
+         removed(i,join(path,old_.name(old_[i])));
+   }
+
+   bool stat(int at, const char* name, record& r)
+   {
+      ++c_.stats;
+      struct statx st;
+      if(0!=::statx(at,name,AT_SYMLINK_NOFOLLOW|AT_STATX_DONT_SYNC,STATX_TYPE|STATX_MODE|STATX_SIZE|STATX_MTIME,&st))
+         return false;
+      r.mode = st.stx_mode;
+      r.size = S_ISREG(st.stx_mode)? st.stx_size : 0;
+      r.mtime = std::int64_t{st.stx_mtime.tv_sec}*1'000'000'000 + st.stx_mtime.tv_nsec;
+      return true;
+   }
+
+   void add(record r, std::string_view name, std::uint64_t origin)
+   {
+      origins_.push_back(origin);
+      r.name = names_.size();
+      r.name_size = static_cast<std::uint32_t>(name.size());
+      r.first_child = r.children = 0;
+      names_.append(name);
+      records_.push_back(r);
+   }
+
+   std::string_view name(const record& r) const noexcept
+   {
+      return std::string_view{names_}.substr(r.name,r.name_size);
+   }
+
+   static std::string join(const std::string& dir, std::string_view name)
+   {
+      std::string path{dir};
+      if(path.empty() || '/'!=path.back())
+         path += '/';
+      path.append(name);
+      return path;
+   }
+
+   void report(char op, const std::string& path, std::uint64_t& counter)
+   {
+      ++counter;
+      w_.change(op,path);
+   }
+
+   out::writer&               w_;
+   const image&               old_;
+   std::vector<record>        records_;
+   std::vector<std::uint64_t> origins_;   // old record of every new one, or 'none'
+   std::string                names_;
+   counters                   c_;
+};
+
+}  // end of namespace snapshot
+
+#endif // FS_SNAPSHOT_H_
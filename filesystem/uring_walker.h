@@ -0,0 +1,529 @@
+#ifndef FS_URING_WALKER_H_
+#define FS_URING_WALKER_H_
+
+#include "dirent_walker.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <list>
+#include <memory>
+#include <ostream>
+#include <string>
+#include <system_error>
+#include <vector>
+
+#include <linux/io_uring.h>
+#include <linux/time_types.h>
+#include <sys/mman.h>
+
+/**
+   Linux backend of 'fs_process' with asynchronous statx and openat through io_uring.
+
+   The synchronous walkers wait for every stat in turn, which is fine on a local disk with a warm cache,
+   but on network-backed or spinning volumes the latency of a single stat dominates the whole walk.
+   Here the requests are queued into the submission ring by hundreds (the queue depth) and are submitted with a single io_uring_enter,
+   completions are handled as they arrive: a completed stat of a directory queues its openat, a completed openat starts listing it.
+   Directories are still read with getdents64 synchronously (io_uring has no such operation), by large buffers.
+   At most 'max_open' directories are open at once, the entries of a directory are queued only as long as there is room in the ring,
+   so the requests in flight and the open descriptors are bounded by the queue depth and 'max_open'.
+   The paths of the directories found but not opened yet are not: they wait in a queue, one string each, as in a breadth-first walk.
+
+   Entries are printed in the order of completion, i.e. the output is the same set of lines as of the other backends, but unordered.
+   No liburing is needed, the rings are set up by the raw syscalls. 'available()' tells whether the running kernel supports
+   the needed operations, otherwise the caller is expected to fall back to the synchronous walker.
+
+   \see https://man7.org/linux/man-pages/man7/io_uring.7.html
+   \see https://kernel.dk/io_uring.pdf
+*/
+
+namespace uring_
+{
+
+/**
+   Submission and completion rings, a minimal subset of liburing.
+*/
+class ring
+{
+public:
+   explicit ring(unsigned entries)
+   {
+      io_uring_params p{};
+      fd_ = static_cast<int>(::syscall(__NR_io_uring_setup,entries,&p));
+      if(fd_<0)
+         throw std::system_error{errno,std::generic_category(),"io_uring_setup"};
+
+      sq_size_ = p.sq_off.array+p.sq_entries*sizeof(unsigned);
+      cq_size_ = p.cq_off.cqes+p.cq_entries*sizeof(io_uring_cqe);
+      const bool single = p.features & IORING_FEAT_SINGLE_MMAP;
+      if(single)
+         sq_size_ = cq_size_ = std::max(sq_size_,cq_size_);
+      sqes_size_ = p.sq_entries*sizeof(io_uring_sqe);
+
+      sq_ = map(sq_size_,IORING_OFF_SQ_RING);
+      cq_ = single? sq_ : map(cq_size_,IORING_OFF_CQ_RING);
+      sqes_ = static_cast<io_uring_sqe*>(map(sqes_size_,IORING_OFF_SQES));
+      if(!sq_ || !cq_ || !sqes_) {
+         const auto e = errno;
+         release();
+         throw std::system_error{e,std::generic_category(),"io_uring mmap"};
+      }
+
+      entries_ = p.sq_entries;
+      sq_head_ = at<unsigned>(sq_,p.sq_off.head);
+      sq_tail_ = at<unsigned>(sq_,p.sq_off.tail);
+      sq_mask_ = *at<unsigned>(sq_,p.sq_off.ring_mask);
+      cq_head_ = at<unsigned>(cq_,p.cq_off.head);
+      cq_tail_ = at<unsigned>(cq_,p.cq_off.tail);
+      cq_mask_ = *at<unsigned>(cq_,p.cq_off.ring_mask);
+      cqes_ = at<io_uring_cqe>(cq_,p.cq_off.cqes);
+      auto* array = at<unsigned>(sq_,p.sq_off.array);
+      for(unsigned i=0; i<entries_; ++i)   // slot i of the ring is always sqes_[i]
+         array[i] = i;
+      tail_ = submitted_ = *sq_tail_;
+   }
+
+   ~ring() { release(); }
+
+   ring(const ring&) = delete;
+   ring& operator=(const ring&) = delete;
+
+   unsigned entries() const noexcept { return entries_; }
+
+   /**
+      \retval true if the kernel supports the operation 'op'
+   */
+   bool supports(unsigned op) const
+   {
+      constexpr unsigned ops{256};
+      std::vector<char> buffer(sizeof(io_uring_probe)+ops*sizeof(io_uring_probe_op));
+      auto* probe = reinterpret_cast<io_uring_probe*>(buffer.data());
+      if(0!=::syscall(__NR_io_uring_register,fd_,IORING_REGISTER_PROBE,probe,ops))
+         return false;
+      return op<=probe->last_op && (probe->ops[op].flags & IO_URING_OP_SUPPORTED);
+   }
+
+   /**
+      \retval a cleared submission queue entry, nullptr if the queue is full
+   */
+   io_uring_sqe* sqe() noexcept
+   {
+      if(tail_-__atomic_load_n(sq_head_,__ATOMIC_ACQUIRE)>=entries_)
+         return nullptr;
+      auto* e = &sqes_[tail_ & sq_mask_];
+      std::memset(e,0,sizeof(*e));
+      ++tail_;
+      return e;
+   }
+
+   /**
+      Submits the queued entries and waits for at least 'wait' completions.
+      \retval number of io_uring_enter calls
+   */
+   unsigned submit(unsigned wait)
+   {
+      __atomic_store_n(sq_tail_,tail_,__ATOMIC_RELEASE);
+      unsigned calls{0};
+      for(;;) {
+         const unsigned pending = tail_-submitted_;
+         if(0==pending && 0==wait)
+            return calls;
+         ++calls;
+         const auto n = ::syscall(__NR_io_uring_enter,fd_,pending,wait,wait? IORING_ENTER_GETEVENTS : 0,nullptr,0);
+         if(n<0) {
+            if(EINTR==errno)
+               continue;
+            if(EAGAIN==errno || EBUSY==errno)   // completions are to be reaped first
+               return calls;
+            throw std::system_error{errno,std::generic_category(),"io_uring_enter"};
+         }
+         submitted_ += static_cast<unsigned>(n);
+         if(tail_==submitted_)
+            return calls;
+         wait = 0;
+      }
+   }
+
+   /**
+      Calls f(cqe) for every available completion.
+   */
+   template <typename F>
+   void reap(F f)
+   {
+      auto head = *cq_head_;
+      for(;;) {
+         const auto tail = __atomic_load_n(cq_tail_,__ATOMIC_ACQUIRE);
+         if(head==tail)
+            break;
+         for(; head!=tail; ++head) {
+            const auto cqe = cqes_[head & cq_mask_];
+            __atomic_store_n(cq_head_,head+1,__ATOMIC_RELEASE);
+            f(cqe);
+         }
+      }
+   }
+
+private:
+   void* map(std::size_t size, std::uint64_t offset) noexcept
+   {
+      void* p = ::mmap(nullptr,size,PROT_READ|PROT_WRITE,MAP_SHARED|MAP_POPULATE,fd_,offset);
+      return MAP_FAILED==p? nullptr : p;
+   }
+
+   template <typename T>
+   static T* at(void* base, std::uint32_t offset) noexcept
+   {
+      return reinterpret_cast<T*>(static_cast<char*>(base)+offset);
+   }
+
+   void release() noexcept
+   {
+      if(sqes_)
+         ::munmap(sqes_,sqes_size_);
+      if(cq_ && cq_!=sq_)
+         ::munmap(cq_,cq_size_);
+      if(sq_)
+         ::munmap(sq_,sq_size_);
+      ::close(fd_);
+   }
+
+   int            fd_{-1};
+   void*          sq_{nullptr};
+   void*          cq_{nullptr};
+   io_uring_sqe*  sqes_{nullptr};
+   std::size_t    sq_size_{0}, cq_size_{0}, sqes_size_{0};
+   unsigned       entries_{0};
+   unsigned*      sq_head_{nullptr};
+   unsigned*      sq_tail_{nullptr};
+   unsigned       sq_mask_{0};
+   unsigned*      cq_head_{nullptr};
+   unsigned*      cq_tail_{nullptr};
+   unsigned       cq_mask_{0};
+   io_uring_cqe*  cqes_{nullptr};
+   unsigned       tail_{0};        // local tail of the submission queue, published by 'submit'
+   unsigned       submitted_{0};
+};
+
+/**
+   \retval true if io_uring is there and supports the operations of the walker
+*/
+inline bool available() noexcept
+{
+   try {
+      ring r{2};
+      return r.supports(IORING_OP_OPENAT) && r.supports(IORING_OP_STATX) && r.supports(IORING_OP_TIMEOUT);
+   }
+   catch(const std::exception&) {
+      return false;
+   }
+}
+
+struct counters
+{
+   std::uint64_t entries{0};
+   std::uint64_t getdents{0};
+   std::uint64_t statx{0};       // asynchronous
+   std::uint64_t openat{0};      // asynchronous
+   std::uint64_t close{0};
+   std::uint64_t enter{0};       // io_uring_enter
+
+   std::uint64_t syscalls() const noexcept { return getdents+close+enter; }
+};
+
+inline std::ostream& operator<<(std::ostream& os, const counters& c)
+{
+   os    << "entries: " << c.entries
+         << ", getdents64: " << c.getdents
+         << ", statx: " << c.statx
+         << ", openat: " << c.openat
+         << ", close: " << c.close
+         << ", io_uring_enter: " << c.enter
+         << ", syscalls per entry: " << (c.entries? double(c.syscalls())/c.entries : 0.);
+   return os;
+}
+
+class walker
+{
+public:
+   static constexpr unsigned default_depth{256};
+
+   /**
+      \param 'max_open' is a limit of simultaneously open directory descriptors
+      \param 'depth' is the number of requests in flight
+      \param 'latency' delays every statx by a linked timeout, it simulates a slow volume for benchmarks
+   */
+   walker(out::writer& os, std::size_t max_open = fs_max_open, unsigned depth = default_depth, std::chrono::microseconds latency = {})
+      :  os_(os)
+        ,ring_(std::max(depth,2u))
+        ,max_open_(std::max<std::size_t>(max_open,1))
+        ,latency_(latency)
+   {}
+
+   /**
+      Requests in flight refer to the directories and buffers of the walker, so they are waited for even after a failure.
+   */
+   ~walker()
+   {
+      try {
+         while(in_flight_) {
+            ring_.submit(1);
+            ring_.reap([this](const io_uring_cqe& cqe){
+               --in_flight_;
+               delete reinterpret_cast<request*>(cqe.user_data);
+            });
+         }
+      }
+      catch(const std::exception&) {
+      }
+      for(auto& d: dirs_)
+         if(d.fd>=0)
+            ::close(d.fd);
+   }
+
+   walker(const walker&) = delete;
+   walker& operator=(const walker&) = delete;
+
+   void run(const std::string& path)
+   {
+      struct statx st;
+      if(0!=::statx(AT_FDCWD,path.c_str(),AT_STATX_DONT_SYNC,STATX_TYPE|STATX_MODE|STATX_SIZE,&st)) {
+         if(ENOENT!=errno)
+            dirent_::fail("cannot get file status",path);
+         os_.missing(path);
+         return;
+      }
+      ++c_.statx;
+      if(print(path,st))
+         pending_.push_back(path);
+
+      while(!pending_.empty() || !dirs_.empty()) {
+         queue();
+         c_.enter += ring_.submit(in_flight_? 1 : 0);
+         ring_.reap([this](const io_uring_cqe& cqe){ complete(cqe); });
+      }
+   }
+
+   const counters& stats() const noexcept { return c_; }
+
+private:
+   struct directory
+   {
+      int                     fd{-1};
+      std::string             path;
+      std::unique_ptr<char[]> buffer;
+      long                    pos{0};
+      long                    size{0};
+      bool                    listed{false};    // all entries have been queued
+      std::size_t             outstanding{0};   // requests in flight
+   };
+   using dir_iterator = std::list<directory>::iterator;
+
+   struct request
+   {
+      bool                 open;    // openat of 'dir', statx of 'path' otherwise
+      dir_iterator         dir;
+      std::string          path;
+      std::size_t          name;    // offset of the name in 'path'
+      struct statx         st;
+      __kernel_timespec    delay;
+   };
+
+   /**
+      Fills the ring: entries of the open directories first, then new directories.
+   */
+   void queue()
+   {
+      const unsigned per_stat = latency_.count()? 2 : 1;
+      while(in_flight_+per_stat<=ring_.entries()) {
+         if(!listing_.empty()) {
+            auto d = listing_.front();
+            const auto* e = next(*d);
+            if(!e) {
+               d->listed = true;
+               listing_.pop_front();
+               done(d);
+               continue;
+            }
+            stat(d,e->d_name,per_stat);
+         }
+         else if(!pending_.empty() && dirs_.size()<max_open_) {
+            auto* r = acquire();
+            r->open = true;
+            r->dir = dirs_.emplace(dirs_.end());
+            r->dir->path = std::move(pending_.front());
+            pending_.pop_front();
+            auto* e = ring_.sqe();
+            e->opcode = IORING_OP_OPENAT;
+            e->fd = AT_FDCWD;
+            e->addr = reinterpret_cast<std::uint64_t>(r->dir->path.c_str());
+            e->open_flags = O_RDONLY|O_DIRECTORY|O_CLOEXEC;
+            e->user_data = reinterpret_cast<std::uint64_t>(r);
+            ++in_flight_;
+            ++r->dir->outstanding;
+            ++c_.openat;
+         }
+         else
+            break;
+      }
+   }
+
+   void stat(dir_iterator d, const char* name, unsigned sqes)
+   {
+      auto* r = acquire();
+      r->open = false;
+      r->dir = d;
+      r->path = d->path;
+      if(r->path.empty() || '/'!=r->path.back())
+         r->path += '/';
+      r->name = r->path.size();
+      r->path += name;
+
+      if(sqes>1) {
+         const auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(latency_).count();
+         r->delay = {ns/1'000'000'000,ns%1'000'000'000};
+         auto* t = ring_.sqe();
+         t->opcode = IORING_OP_TIMEOUT;
+         t->flags = IOSQE_IO_LINK;
+         t->fd = -1;
+         t->addr = reinterpret_cast<std::uint64_t>(&r->delay);
+         t->len = 1;
+         t->timeout_flags = IORING_TIMEOUT_ETIME_SUCCESS;   // the expiry does not break the link
+         t->user_data = 0;
+         ++in_flight_;
+      }
+      auto* e = ring_.sqe();
+      e->opcode = IORING_OP_STATX;
+      e->fd = d->fd;
+      e->addr = reinterpret_cast<std::uint64_t>(r->path.c_str()+r->name);
+      e->len = STATX_TYPE|STATX_MODE|STATX_SIZE;
+      e->off = reinterpret_cast<std::uint64_t>(&r->st);
+      e->statx_flags = AT_STATX_DONT_SYNC;
+      e->user_data = reinterpret_cast<std::uint64_t>(r);
+      ++in_flight_;
+      ++d->outstanding;
+      ++c_.statx;
+   }
+
+   void complete(const io_uring_cqe& cqe)
+   {
+      --in_flight_;
+      if(0==cqe.user_data)   // a timeout of the simulated latency
+         return;
+      std::unique_ptr<request> r{reinterpret_cast<request*>(cqe.user_data)};
+      const auto d = r->dir;
+      --d->outstanding;
+
+      if(r->open) {
+         if(cqe.res<0) {
+            errno = -cqe.res;
+            dirent_::fail("cannot open directory",d->path);
+         }
+         d->fd = cqe.res;
+         if(pool_.empty())
+            d->buffer.reset(new char[dirent_::walker::buffer_size]);
+         else {
+            d->buffer = std::move(pool_.back());
+            pool_.pop_back();
+         }
+         listing_.push_back(d);
+      }
+      else if(cqe.res<0) {
+         if(-ENOENT!=cqe.res) {
+            errno = -cqe.res;
+            dirent_::fail("cannot get file status",r->path);
+         }
+         os_.missing(r->path);
+      }
+      else if(print(r->path,r->st))
+         pending_.push_back(std::move(r->path));
+
+      release(std::move(r));
+      done(d);
+   }
+
+   /**
+      Closes a directory when all its entries are queued and done.
+   */
+   void done(dir_iterator d)
+   {
+      if(!d->listed || d->outstanding)
+         return;
+      ++c_.close;
+      ::close(d->fd);
+      pool_.push_back(std::move(d->buffer));
+      dirs_.erase(d);
+   }
+
+   const dirent_::linux_dirent64* next(directory& d)
+   {
+      for(;;) {
+         if(d.pos>=d.size) {
+            ++c_.getdents;
+            d.size = ::syscall(SYS_getdents64,d.fd,d.buffer.get(),dirent_::walker::buffer_size);
+            d.pos = 0;
+            if(d.size<0)
+               dirent_::fail("cannot read directory",d.path);
+            if(0==d.size)
+               return nullptr;
+         }
+         const auto* e = reinterpret_cast<const dirent_::linux_dirent64*>(d.buffer.get()+d.pos);
+         d.pos += e->d_reclen;
+         if(!dirent_::is_dot(e->d_name)) {
+            ++c_.entries;
+            return e;
+         }
+      }
+   }
+
+   /**
+      \retval true if the entity is a directory
+   */
+   bool print(const std::string& path, const struct statx& st)
+   {
+      const auto type = dirent_::from_mode(st.stx_mode);
+      os_.entry(type,fs::perms(st.stx_mode & 07777),fs::file_type::regular==type? st.stx_size : 0,path);
+      return fs::file_type::directory==type;
+   }
+
+   request* acquire()
+   {
+      if(requests_.empty())
+         return new request;
+      auto* r = requests_.back().release();
+      requests_.pop_back();
+      return r;
+   }
+
+   void release(std::unique_ptr<request> r)
+   {
+      requests_.push_back(std::move(r));
+   }
+
+   out::writer&                           os_;
+   ring                                   ring_;
+   const std::size_t                      max_open_;
+   const std::chrono::microseconds        latency_;
+   unsigned                               in_flight_{0};   // submission queue entries not completed yet
+   std::list<directory>                   dirs_;           // open or being opened
+   std::deque<dir_iterator>               listing_;        // open directories with entries to queue
+   std::deque<std::string>                pending_;        // directories to open
+   std::vector<std::unique_ptr<char[]>>   pool_;
+   std::vector<std::unique_ptr<request>>  requests_;       // free ones
+   counters                               c_;
+};
+
+}  // end of namespace uring_
+
+/**
+   \retval counters of the walk
+*/
+inline uring_::counters fs_process_uring(out::writer& os, const fs::path& p, std::size_t max_open = fs_max_open, unsigned depth = uring_::walker::default_depth)
+{
+   uring_::walker w{os,max_open,depth};
+   w.run(p.string());
+   return w.stats();
+}
+
+#endif // FS_URING_WALKER_H_
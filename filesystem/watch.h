@@ -0,0 +1,409 @@
+#ifndef FS_WATCH_H_
+#define FS_WATCH_H_
+
+#include "listing.h"
+
+#include <chrono>
+#include <cstdint>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <set>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include <poll.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+
+/**
+   Live in-memory tree of a directory kept up to date with inotify.
+
+   After the initial walk every directory of the tree is watched. A node keeps the status of its entity and the cumulative
+   size and number of files of its subtree, any change is propagated to the ancestors only, so "total size under X"
+   is answered in O(depth) without re-walking anything.
+
+   Events are coalesced: after the first one the watcher keeps reading for a short window and collects the distinct
+   (directory,name) pairs only, then every pair is re-examined once. A burst of writes into a file costs one stat.
+   A rename within the tree (IN_MOVED_FROM and IN_MOVED_TO of the same cookie) re-parents the node: its subtree and its
+   watches stay as they are, nothing is walked again.
+   When the kernel queue overflows, the tree is rebuilt from scratch.
+   Symbolic links are not followed.
+
+   \see https://man7.org/linux/man-pages/man7/inotify.7.html
+*/
+
+namespace watch
+{
+
+struct node
+{
+   fs::file_status   status;
+   std::uintmax_t    size{0};       // own size, of regular files only
+   std::uintmax_t    bytes{0};      // of the subtree
+   std::uintmax_t    files{0};      // of the subtree
+   node*             parent{nullptr};
+   std::string       name;
+   int               wd{-1};        // of a watched directory
+   std::map<std::string,std::unique_ptr<node>> children;
+};
+
+class tree
+{
+public:
+   static constexpr std::uint32_t events =
+      IN_CREATE|IN_DELETE|IN_MODIFY|IN_CLOSE_WRITE|IN_ATTRIB|IN_MOVED_FROM|IN_MOVED_TO|IN_DONT_FOLLOW|IN_ONLYDIR;
+
+   tree(out::writer& w, const fs::path& root, std::chrono::milliseconds window)
+      :  w_(w)
+        ,fd_(::inotify_init1(IN_NONBLOCK|IN_CLOEXEC))
+        ,root_path_(root)
+        ,window_(window)
+   {
+      if(fd_<0)
+         throw std::system_error{errno,std::generic_category(),"inotify_init1"};
+      rebuild();
+   }
+
+   ~tree() { ::close(fd_); }
+
+   tree(const tree&) = delete;
+   tree& operator=(const tree&) = delete;
+
+   int fd() const noexcept { return fd_; }
+   std::size_t watched() const noexcept { return watches_.size(); }
+
+   /**
+      \retval the node of 'p' (the root or a path under it), nullptr if there is no such one
+   */
+   const node* find(const fs::path& p) const
+   {
+      const auto rel = p.lexically_relative(root_path_);
+      if(rel.empty() || *rel.begin()=="..")
+         return nullptr;
+      const node* n = root_.get();
+      for(const auto& part: rel) {
+         if(part=="." || part.empty())
+            continue;
+         const auto it = n->children.find(part.string());
+         if(n->children.end()==it)
+            return nullptr;
+         n = it->second.get();
+      }
+      return n;
+   }
+
+   /**
+      Reads and applies one coalesced batch of events, blocking for the window after the first event.
+   */
+   void process()
+   {
+      batch b;
+      bool overflow{false};
+      const auto deadline = std::chrono::steady_clock::now()+window_;
+      for(;;) {
+         overflow |= read(b);
+         const auto left = std::chrono::duration_cast<std::chrono::milliseconds>(deadline-std::chrono::steady_clock::now());
+         if(left.count()<=0)
+            break;
+         pollfd p{fd_,POLLIN,0};
+         if(::poll(&p,1,static_cast<int>(left.count()))<=0)
+            break;
+      }
+
+      if(overflow) {
+         w_.change('!',root_path_.native());
+         rebuild();
+      }
+      else {
+         for(const auto& m: b.moves)
+            move(m);
+         for(const auto& [wd,name]: b.dirty) {   // the moved names too: a rename may replace an entry or come from outside
+            const auto it = watches_.find(wd);
+            if(watches_.end()!=it)
+               reconcile(*it->second,name);
+         }
+      }
+      w_.flush();
+   }
+
+private:
+   using entry = std::pair<int,std::string>;   // (watch descriptor of the directory,name)
+
+   struct batch
+   {
+      std::set<entry>                              dirty;
+      std::unordered_map<std::uint32_t,entry>      moved_from;   // by cookie
+      std::vector<std::pair<entry,entry>>          moves;        // paired (from,to), in order
+   };
+
+   /**
+      \retval true if the event queue has overflowed
+   */
+   bool read(batch& b)
+   {
+      alignas(inotify_event) char buffer[64*1024];
+      bool overflow{false};
+      for(;;) {
+         const auto n = ::read(fd_,buffer,sizeof(buffer));
+         if(n<=0)
+            return overflow;
+         for(long pos=0; pos<n;) {
+            const auto* e = reinterpret_cast<const inotify_event*>(buffer+pos);
+            pos += sizeof(inotify_event)+e->len;
+            if(e->mask & IN_Q_OVERFLOW)
+               overflow = true;
+            else if(e->mask & IN_IGNORED) {
+               const auto it = watches_.find(e->wd);
+               if(watches_.end()!=it) {
+                  it->second->wd = -1;
+                  watches_.erase(it);
+               }
+            }
+            else if(e->len) {
+               b.dirty.emplace(e->wd,e->name);
+               if(e->mask & IN_MOVED_FROM)
+                  b.moved_from[e->cookie] = {e->wd,e->name};
+               else if(e->mask & IN_MOVED_TO) {
+                  const auto from = b.moved_from.find(e->cookie);
+                  if(b.moved_from.end()!=from) {
+                     b.moves.emplace_back(std::move(from->second),entry{e->wd,e->name});
+                     b.moved_from.erase(from);
+                  }
+               }
+            }
+         }
+      }
+   }
+
+   void rebuild()
+   {
+      for(const auto& [wd,n]: watches_)
+         ::inotify_rm_watch(fd_,wd);
+      watches_.clear();
+      root_ = std::make_unique<node>();
+      root_->status = fs::symlink_status(root_path_);
+      root_->name = root_path_.native();
+      if(fs::file_type::not_found==root_->status.type())
+         throw fs::filesystem_error{"cannot watch",root_path_,std::make_error_code(std::errc::no_such_file_or_directory)};
+      populate(*root_,root_path_);
+   }
+
+   /**
+      Reads the subtree of a new node and starts watching its directories.
+   */
+   void populate(node& n, const fs::path& p)
+   {
+      if(fs::file_type::regular==n.status.type()) {
+         std::error_code ec;
+         n.size = fs::file_size(p,ec);
+         if(ec)
+            n.size = 0;
+         n.bytes = n.size;
+         n.files = 1;
+         return;
+      }
+      if(fs::file_type::directory!=n.status.type())
+         return;
+
+      n.wd = ::inotify_add_watch(fd_,p.c_str(),events);
+      if(n.wd>=0)
+         watches_[n.wd] = &n;
+      std::error_code ec;
+      for(const auto& i: fs::directory_iterator{p,ec}) {
+         auto child = std::make_unique<node>();
+         child->status = i.symlink_status(ec);
+         if(ec)
+            continue;
+         child->parent = &n;
+         child->name = i.path().filename().native();
+         populate(*child,i.path());
+         n.bytes += child->bytes;
+         n.files += child->files;
+         n.children.emplace(child->name,std::move(child));
+      }
+   }
+
+   /**
+      Brings the entry 'name' of the directory 'dir' in line with the filesystem.
+   */
+   void reconcile(node& dir, const std::string& name)
+   {
+      const auto p = path(dir)/name;
+      std::error_code ec;
+      const auto status = fs::symlink_status(p,ec);
+      const bool exists = !ec && fs::file_type::not_found!=status.type();
+      const auto it = dir.children.find(name);
+
+      if(dir.children.end()!=it && exists && it->second->status.type()==status.type()) {
+         auto& n = *it->second;
+         if(fs::file_type::regular!=status.type()) {
+            n.status = status;
+            return;
+         }
+         const auto size = fs::file_size(p,ec);
+         if(ec || (size==n.size && status.permissions()==n.status.permissions()))
+            return;
+         n.status = status;
+         adjust(&dir,std::intmax_t(size)-std::intmax_t(n.size),0);
+         n.size = n.bytes = size;
+         w_.change('M',p.native());
+         return;
+      }
+
+      if(dir.children.end()!=it) {
+         remove(*it->second);
+         adjust(&dir,-std::intmax_t(it->second->bytes),-std::intmax_t(it->second->files));
+         dir.children.erase(it);
+         w_.change('-',p.native());
+      }
+      if(exists) {
+         auto child = std::make_unique<node>();
+         child->status = status;
+         child->parent = &dir;
+         child->name = name;
+         populate(*child,p);
+         adjust(&dir,child->bytes,child->files);
+         dir.children.emplace(name,std::move(child));
+         w_.change('+',p.native());
+      }
+   }
+
+   /**
+      Re-parents the node of a renamed entry, an entry it replaces is removed.
+      The rest is left to 'reconcile': if either directory is gone or the node is not there, nothing is moved.
+   */
+   void move(const std::pair<entry,entry>& m)
+   {
+      const auto from = watches_.find(m.first.first);
+      const auto to = watches_.find(m.second.first);
+      if(watches_.end()==from || watches_.end()==to)
+         return;
+      node& src = *from->second;
+      node& dst = *to->second;
+      const auto it = src.children.find(m.first.second);
+      if(src.children.end()==it)
+         return;
+      for(const node* a = &dst; a; a = a->parent)   // stale events: never under itself
+         if(a==it->second.get())
+            return;
+
+      const auto old_path = path(*it->second);
+      auto n = std::move(it->second);
+      src.children.erase(it);
+      adjust(&src,-std::intmax_t(n->bytes),-std::intmax_t(n->files));
+      if(const auto replaced = dst.children.find(m.second.second); dst.children.end()!=replaced) {
+         remove(*replaced->second);
+         adjust(&dst,-std::intmax_t(replaced->second->bytes),-std::intmax_t(replaced->second->files));
+         dst.children.erase(replaced);
+      }
+      n->parent = &dst;
+      n->name = m.second.second;
+      adjust(&dst,n->bytes,n->files);
+      w_.change('-',old_path.native());
+      w_.change('+',path(*n).native());
+      dst.children.emplace(n->name,std::move(n));
+   }
+
+   /**
+      Stops watching the directories of a subtree being dropped.
+      A watch descriptor already taken over by another node is left alone: 'inotify_add_watch' of the same directory
+      under a new name (a rename seen as a removal and an addition) returns the same descriptor.
+   */
+   void remove(node& n)
+   {
+      if(n.wd>=0) {
+         const auto it = watches_.find(n.wd);
+         if(watches_.end()!=it && &n==it->second) {
+            ::inotify_rm_watch(fd_,n.wd);
+            watches_.erase(it);
+         }
+         n.wd = -1;
+      }
+      for(auto& [name,child]: n.children)
+         remove(*child);
+   }
+
+   /**
+      O(depth): a change of a subtree is propagated to the ancestors only.
+   */
+   static void adjust(node* n, std::intmax_t bytes, std::intmax_t files)
+   {
+      for(; n; n = n->parent) {
+         n->bytes += bytes;
+         n->files += files;
+      }
+   }
+
+   fs::path path(const node& n) const
+   {
+      if(!n.parent)
+         return root_path_;
+      return path(*n.parent)/n.name;
+   }
+
+   out::writer&                  w_;
+   const int                     fd_;
+   const fs::path                root_path_;
+   const std::chrono::milliseconds window_;
+   std::unique_ptr<node>         root_;
+   std::unordered_map<int,node*> watches_;
+};
+
+/**
+   Watches 'root' and answers the queries read from 'in':
+      du <path>   cumulative size and number of files under <path>
+      quit
+   Changes are reported as they are applied: '+' added, '-' removed, 'M' modified, '!' rebuilt after an overflow.
+*/
+inline void run(out::writer& w, const fs::path& root, std::chrono::milliseconds window)
+{
+   tree t{w,root,window};
+   std::cerr << "watching " << t.watched() << " directories" << std::endl;
+
+   bool input{true};
+   std::string pending;
+   for(;;) {
+      pollfd p[2] = {{t.fd(),POLLIN,0},{STDIN_FILENO,POLLIN,0}};
+      if(::poll(p,input? 2 : 1,-1)<0) {
+         if(EINTR==errno)
+            continue;
+         throw std::system_error{errno,std::generic_category(),"poll"};
+      }
+      if(p[0].revents & POLLIN)
+         t.process();
+      if(!input || !(p[1].revents & (POLLIN|POLLHUP)))
+         continue;
+
+      char buffer[4096];
+      const auto n = ::read(STDIN_FILENO,buffer,sizeof(buffer));
+      if(n<=0) {
+         input = false;
+         continue;
+      }
+      pending.append(buffer,n);
+      for(auto eol = pending.find('\n'); std::string::npos!=eol; eol = pending.find('\n')) {
+         const auto line = pending.substr(0,eol);
+         pending.erase(0,eol+1);
+         if(line=="quit")
+            return;
+         if(0==line.rfind("du ",0)) {
+            const fs::path q{line.substr(3)};
+            if(const auto* n = t.find(q)) {
+               char size[24];
+               std::cout << std::string(size,fs_size(n->bytes,size)) << " " << n->bytes << " bytes, " << n->files << " files" << std::endl;
+            }
+            else
+               std::cout << q << " is not watched" << std::endl;
+         }
+         else
+            std::cout << "commands: du <path> | quit" << std::endl;
+      }
+   }
+}
+
+}  // end of namespace watch
+
+#endif // FS_WATCH_H_
@@ -0,0 +1,98 @@
+#ifndef FS_WORK_STEALING_H_
+#define FS_WORK_STEALING_H_
+
+#include <atomic>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/**
+   Work-stealing scheduler of the parallel walkers.
+   Every worker owns a deque of pending tasks, takes work from its back (depth first, warm caches)
+   and, being idle, steals from the front of the others (big subtrees first).
+   A worker returns when there is no pending task in the whole pool, including the ones being executed right now.
+
+   \see https://github.com/nikolaAV/Modern-Cpp/tree/master/filesystem
+*/
+
+namespace parallel
+{
+
+template <typename Task>
+class work_stealing_pool
+{
+public:
+   explicit work_stealing_pool(std::size_t workers)
+      :  queues_(workers? workers : 1)
+   {}
+
+   work_stealing_pool(const work_stealing_pool&) = delete;
+   work_stealing_pool& operator=(const work_stealing_pool&) = delete;
+
+   std::size_t size() const noexcept { return queues_.size(); }
+
+   void push(std::size_t self, Task t)
+   {
+      pending_.fetch_add(1,std::memory_order_relaxed);
+      std::lock_guard lock{queues_[self].m};
+      queues_[self].q.push_back(std::move(t));
+   }
+
+   /**
+      Executes f(self,task) for the tasks of its own and stolen ones until the pool has drained.
+      'f' may push new tasks, it must not throw.
+   */
+   template <typename F>
+   void work(std::size_t self, F f)
+   {
+      Task t;
+      while(0!=pending_.load(std::memory_order_acquire)) {
+         if(!pop(self,t) && !steal(self,t)) {
+            std::this_thread::yield();
+            continue;
+         }
+         f(self,t);
+         pending_.fetch_sub(1,std::memory_order_acq_rel);
+      }
+   }
+
+private:
+   struct task_queue
+   {
+      std::mutex        m;
+      std::deque<Task>  q;
+   };
+
+   bool pop(std::size_t self, Task& t)
+   {
+      auto& own = queues_[self];
+      std::lock_guard lock{own.m};
+      if(own.q.empty())
+         return false;
+      t = std::move(own.q.back());
+      own.q.pop_back();
+      return true;
+   }
+
+   bool steal(std::size_t self, Task& t)
+   {
+      for(std::size_t i=1; i<queues_.size(); ++i) {
+         auto& victim = queues_[(self+i)%queues_.size()];
+         std::lock_guard lock{victim.m};
+         if(!victim.q.empty()) {
+            t = std::move(victim.q.front());
+            victim.q.pop_front();
+            return true;
+         }
+      }
+      return false;
+   }
+
+   std::vector<task_queue>    queues_;
+   std::atomic<std::size_t>   pending_{0};
+};
+
+}  // end of namespace parallel
+
+#endif // FS_WORK_STEALING_H_
@@ -0,0 +1,546 @@
+/**
+   The hand-built anchor scanner versus 'sregex_iterator' (variant 1), sequential and parallel.
+   First all of them are checked to give the same matches: on the cppreference page, on a synthetic corpus
+   and on random fragments full of near misses, the parallel extraction with tiny chunks to stitch at many boundaries.
+   A pattern set is checked to give every pattern the matches of its own 'sregex_iterator', ordered by position.
+   The push parser of a stream is checked on the same inputs split into chunks of a few bytes.
+   The clean-up of the text is checked on cases of character references and of invalid UTF-8.
+   The normalization of links is checked on cases of RFC 3986, the index of unique links against an 'unordered_map'.
+   The range of 'scan::links' is checked to allocate nothing at all, by counting the calls of the global 'operator new'.
+   Then the throughput is measured on the synthetic corpus: the scanner, and the pattern set against one regex pass per pattern.
+
+   The suite runs every engine over corpora of increasing size and link density and prints one tab separated line per run
+   (engine, size, density, links, seconds, GB/s, allocations, peak heap bytes) to compare versions with 'diff' or a spreadsheet.
+   The engines: 'std::regex' with the ECMAScript and the POSIX extended grammar, with 'regex::optimize',
+   by 'cregex_iterator' and by 'cregex_token_iterator', the scanner and the push parser.
+   The heap is measured by the replaced 'operator new' and 'operator delete'.
+
+   Usage: benchmark [megabytes=64] [jobs=hardware_concurrency]
+          benchmark --suite [megabytes=16]
+*/
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <iterator>
+#include <new>
+#include <random>
+#include <regex>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "scanner.h"
+#include "parallel.h"
+#include "patterns.h"
+#include "stream.h"
+#include "text.h"
+#include "urls.h"
+
+#include <malloc.h>
+
+using namespace std;
+
+atomic<size_t> allocations{0};
+atomic<size_t> heap{0}, peak{0};   // bytes
+
+void* operator new(size_t size)
+{
+   allocations.fetch_add(1,memory_order_relaxed);
+   void* p = malloc(size? size : 1);
+   if(!p)
+      throw bad_alloc{};
+   const auto now = heap.fetch_add(malloc_usable_size(p),memory_order_relaxed)+malloc_usable_size(p);
+   for(auto top = peak.load(memory_order_relaxed); top<now && !peak.compare_exchange_weak(top,now,memory_order_relaxed);)
+      ;
+   return p;
+}
+
+void operator delete(void* p) noexcept
+{
+   if(p)
+      heap.fetch_sub(malloc_usable_size(p),memory_order_relaxed);
+   free(p);
+}
+
+void operator delete(void* p, size_t) noexcept
+{
+   if(p)
+      heap.fetch_sub(malloc_usable_size(p),memory_order_relaxed);
+   free(p);
+}
+
+/**
+   \retval the number of allocations f() made
+*/
+template <typename F>
+size_t allocated(F f)
+{
+   const auto before = allocations.load();
+   f();
+   return allocations.load()-before;
+}
+
+const regex reg{"<a href=\"([^\"]*)\"[^<]*>([^<]*)</a>"};
+
+using matches = vector<pair<string_view,string_view>>;
+
+matches by_regex(string_view in)
+{
+   matches v;
+   cregex_iterator it{in.data(), in.data()+in.size(), reg};
+   for (; it != cregex_iterator{}; ++it)
+      v.emplace_back(string_view{(*it)[1].first,size_t((*it)[1].length())},string_view{(*it)[2].first,size_t((*it)[2].length())});
+   return v;
+}
+
+matches by_scanner(string_view in)
+{
+   matches v;
+   scan::extract(in,[&v](string_view href, string_view text){ v.emplace_back(href,text); });
+   return v;
+}
+
+matches by_range(string_view in)
+{
+   matches v;
+   for(const auto& [match,href,text]: scan::links{in})
+      v.emplace_back(href,text);
+   return v;
+}
+
+/**
+   The text of the matches of the push parser fed by chunks of 1..'chunk' bytes.
+*/
+vector<pair<string,string>> pushed(string_view in, size_t chunk, unsigned seed = 1)
+{
+   vector<pair<string,string>> v;
+   const auto emit = [&v](string_view href, string_view text){ v.emplace_back(href,text); };
+   stream::link_parser parser{64*1024};
+   mt19937 gen{seed};
+   for(size_t i=0; i<in.size();) {
+      const size_t n = min<size_t>(1+gen()%chunk,in.size()-i);
+      parser.feed(in.substr(i,n),emit);
+      i += n;
+   }
+   parser.finish(emit);
+   return v;
+}
+
+bool same_text(const matches& a, const vector<pair<string,string>>& b)
+{
+   return a.size()==b.size() && equal(a.begin(),a.end(),b.begin(),[](const auto& x, const auto& y){ return x.first==y.first && x.second==y.second; });
+}
+
+matches in_parallel(string_view in, size_t jobs, size_t chunk = parallel::default_chunk)
+{
+   matches v;
+   parallel::extract(in,jobs,scan::next,[&v](string_view href, string_view text){ v.emplace_back(href,text); },chunk);
+   return v;
+}
+
+const vector<pair<string,patterns::flags>> pattern_list{
+   {"<a href=\"([^\"]*)\"[^<]*>([^<]*)</a>", regex::ECMAScript},
+   {"https?://[^\"]*", regex::ECMAScript},
+   {"class=\"[a-z]+\"", regex::ECMAScript},
+   {"<P CLASS", regex::ECMAScript|regex::icase},
+   {"[0-9]+px", regex::ECMAScript},
+   {"</?p>", regex::ECMAScript},
+};
+
+/**
+   \retval true if the pattern set gives every pattern the matches of its own 'sregex_iterator', ordered by position
+*/
+bool check_set(string_view in)
+{
+   auto list = pattern_list;
+   list.emplace_back("</\\{0,1\\}p>",regex::basic);   // "\{" is an interval here, not a literal
+   const patterns::pattern_set set{list};
+   vector<vector<string_view>> by_set(set.size());
+   const char* last{nullptr};
+   bool ordered{true};
+   set.scan(in.data(),in.data()+in.size(),[&](size_t i, const cmatch& m) {
+      ordered = ordered && (!last || last<=m[0].first);
+      last = m[0].first;
+      by_set[i].emplace_back(m[0].first,m.length(0));
+   });
+   for(size_t i=0; i<set.size(); ++i) {
+      vector<string_view> own;
+      const auto re = patterns::compiled(list[i].first,list[i].second);
+      for(cregex_iterator it{in.data(),in.data()+in.size(),*re}; it!=cregex_iterator{}; ++it)
+         own.emplace_back((*it)[0].first,it->length(0));
+      if(own.size()!=by_set[i].size() || !equal(own.begin(),own.end(),by_set[i].begin(),[](auto a, auto b){ return a.data()==b.data() && a.size()==b.size(); }))
+         return false;
+   }
+   return ordered;
+}
+
+/**
+   Same views, i.e. the same positions in the input, not only the same text.
+*/
+bool same(const matches& a, const matches& b)
+{
+   if(a.size()!=b.size())
+      return false;
+   for(size_t i=0; i<a.size(); ++i)
+      if(a[i].first.data()!=b[i].first.data() || a[i].first.size()!=b[i].first.size()
+         || a[i].second.data()!=b[i].second.data() || a[i].second.size()!=b[i].second.size())
+         return false;
+   return true;
+}
+
+/**
+   HTML-like text: paragraphs and tags with a link every 'density' tags, about 'size' bytes.
+*/
+string corpus(size_t size, size_t density, unsigned seed = 1)
+{
+   mt19937 gen{seed};
+   const auto word = [&gen]{
+      static const string letters{"abcdefghijklmnopqrstuvwxyz"};
+      string w(1+gen()%9,' ');
+      for(auto& c: w)
+         c = letters[gen()%letters.size()];
+      return w;
+   };
+   string s;
+   s.reserve(size+256);
+   for(size_t tag=0; s.size()<size; ++tag) {
+      if(0==tag%density)
+         s += "<a href=\"https://" + word() + ".org/" + word() + "\" class=\"" + word() + "\">" + word() + " " + word() + "</a>";
+      else
+         s += "<p class=\"" + word() + "\">" + word() + " " + word() + " " + word() + "</p>\n";
+   }
+   return s;
+}
+
+/**
+   Random fragments of the pieces the pattern is made of, most of them near misses.
+*/
+string fragments(size_t n, unsigned seed)
+{
+   static const string pieces[] = {"<a href=\"", "<a href=", "<a", "<", ">", "\"", "</a>", "</a", "</b>", "x", " ", "\n", "=", "a"};
+   mt19937 gen{seed};
+   string s;
+   for(size_t i=0; i<n; ++i)
+      s += pieces[gen()%size(pieces)];
+   return s;
+}
+
+template <typename F>
+double measure(F f)
+{
+   const auto start = chrono::steady_clock::now();
+   f();
+   return chrono::duration<double>(chrono::steady_clock::now()-start).count();
+}
+
+/**
+   \retval true if the clean-up gives the expected text, and nothing but a view of the input if it is plain
+*/
+bool check_text()
+{
+   const pair<string_view,string_view> cases[] = {
+      {"plain text", "plain text"},
+      {"a &amp; b &lt;c&gt; &quot;d&quot;", "a & b <c> \"d\""},
+      {"&#65;&#x42;&#X43;&#x20AC;&#128512;", "ABC\u20AC\U0001F600"},
+      {"&#0;&#xD800;&#x110000;&#99999999999;", "\uFFFD\uFFFD\uFFFD\uFFFD"},
+      {"&unknown; & &; &#; &#x; &#12a; &amp", "&unknown; & &; &#; &#x; &#12a; &amp"},
+      {"caf\xC3\xA9 \xE2\x82\xAC \xF0\x9F\x98\x80", "caf\u00E9 \u20AC \U0001F600"},
+      {"\xC0\xAF \xE0\x80\xAF \xED\xA0\x80 \xF4\x90\x80\x80 \xFF \xC3", "\uFFFD\uFFFD \uFFFD\uFFFD\uFFFD \uFFFD\uFFFD\uFFFD \uFFFD\uFFFD\uFFFD\uFFFD \uFFFD \uFFFD"},
+      {"&nbsp;&hellip;&mdash;&rsquo;&trade;", "\u00A0\u2026\u2014\u2019\u2122"},
+      {"\xE2\x82" "A \xF0\x9F\x98 \xE2\x82\xE2\x82\xAC \xF4\x8F\xBF", "\uFFFD" "A \uFFFD \uFFFD\u20AC \uFFFD"},   // maximal subparts
+   };
+   string buffer;
+   for(const auto& [in,expected]: cases) {
+      const auto out = text::clean(in,buffer);
+      if(out!=expected || (text::plain(in) && out.data()!=in.data())) {
+         cout << "clean-up of " << quoted(string{in}) << " gives " << quoted(string{out}) << endl;
+         return false;
+      }
+   }
+   return true;
+}
+
+/**
+   Links of 'hosts' hosts, with 'paths' paths each, in several spellings of the same.
+*/
+vector<string> links(size_t n, size_t hosts, size_t paths, unsigned seed = 1)
+{
+   mt19937 gen{seed};
+   vector<string> v;
+   v.reserve(n);
+   for(size_t i=0; i<n; ++i) {
+      const auto host = to_string(gen()%hosts), path = to_string(gen()%paths);
+      switch(gen()%4) {
+      case 0:  v.push_back("https://www.host" + host + ".org/some/path/" + path + "?q=" + path); break;
+      case 1:  v.push_back("HTTPS://WWW.Host" + host + ".ORG:443/some/./other/../path/" + path + "?q=" + path + "#top"); break;
+      case 2:  v.push_back("http://host" + host + ".net/" + path); break;
+      default: v.push_back("http://HOST" + host + ".NET:80/a/../" + path + "#" + to_string(gen())); break;
+      }
+   }
+   return v;
+}
+
+/**
+   \retval true if the links are normalized as expected, and counted as by an 'unordered_map'
+*/
+bool check_urls()
+{
+   const pair<string_view,string_view> cases[] = {
+      {"HTTP://Example.COM:80/a/./b/../c#frag", "http://example.com/a/c"},
+      {"https://example.com:443", "https://example.com/"},
+      {"https://example.com:8443?x=1", "https://example.com:8443/?x=1"},
+      {"http://User:Pw@Example.com:/", "http://User:Pw@example.com/"},
+      {"http://[::1]:80/x", "http://[::1]/x"},
+      {"http://[::1]/x", "http://[::1]/x"},
+      {"ftp://host:21/../a/..", "ftp://host/"},
+      {"/a/b/c/./../../g", "/a/g"},
+      {"/a/b/.", "/a/b/"},
+      {"/./", "/"},
+      {"mid/content=5/../6", "mid/content=5/../6"},
+      {"../x/./y?a/../b#c", "../x/./y?a/../b"},
+      {"mailto:Someone@Example.com", "mailto:Someone@Example.com"},
+      {"#top", ""},
+   };
+   string buffer;
+   for(const auto& [in,expected]: cases)
+      if(urls::normalize(in,buffer)!=expected) {
+         cout << "normalization of " << quoted(string{in}) << " gives " << quoted(buffer) << endl;
+         return false;
+      }
+
+   urls::index index;
+   unordered_map<string,uint32_t> counts;
+   vector<string> order;
+   for(const auto& l: links(200'000,300,100)) {
+      const auto url = urls::normalize(l,buffer);
+      index.add(url);
+      if(1==++counts[string{url}])
+         order.emplace_back(url);
+   }
+   size_t i{0};
+   bool same{index.size()==counts.size()};
+   index.for_each([&](string_view url, uint32_t count) {
+      same = same && i<order.size() && url==order[i] && count==counts[order[i]];
+      ++i;
+   });
+   if(!same) {
+      cout << "the index of links differs from an unordered_map" << endl;
+      return false;
+   }
+   return true;
+}
+
+/**
+   \retval true if all the engines agree on the cppreference page and on the random fragments
+*/
+bool verify()
+{
+   stringstream page;
+   page << ifstream{"Regular expressions library - cppreference.com.html"}.rdbuf();
+   const auto text = page.str();
+   if(!same(by_regex(text),by_scanner(text))) {
+      cout << "mismatch on the cppreference page" << endl;
+      return false;
+   }
+   if(!same_text(by_scanner(text),pushed(text,1)) || !same_text(by_scanner(text),pushed(text,4096))) {
+      cout << "push parser mismatch on the cppreference page" << endl;
+      return false;
+   }
+   if(!check_set(text)) {
+      cout << "pattern set mismatch on the cppreference page" << endl;
+      return false;
+   }
+   if(!check_text() || !check_urls())
+      return false;
+   for(unsigned seed=0; seed<20'000; ++seed) {
+      const auto s = fragments(2+seed%40,seed);
+      const auto r = by_regex(s);
+      if(!same(r,by_scanner(s)) || !same(r,by_range(s)) || !same(r,in_parallel(s,3,1+seed%7)) || !same_text(r,pushed(s,1+seed%7,seed)) || (0==seed%10 && !check_set(s))) {
+         cout << "mismatch on " << quoted(s) << endl;
+         return false;
+      }
+   }
+   return true;
+}
+
+struct engine
+{
+   string                                 name;
+   function<size_t(string_view in)>       links;   // the number found
+};
+
+template <typename Iterator, typename... Args>
+size_t count(string_view in, const regex& re, Args... args)
+{
+   size_t n{0};
+   for(Iterator it{in.data(),in.data()+in.size(),re,args...}; it!=Iterator{}; ++it)
+      ++n;
+   return n;
+}
+
+/**
+   Every engine over corpora of 1, 4, 16... MiB up to 'megabytes', with a link every 2, 8 and 32 tags.
+*/
+int suite(size_t megabytes)
+{
+   const string pattern{"<a href=\"([^\"]*)\"[^<]*>([^<]*)</a>"};
+   const regex ecmascript{pattern,regex::ECMAScript};
+   const regex optimized{pattern,regex::ECMAScript|regex::optimize};
+   const regex extended{pattern,regex::extended};
+   const vector<engine> engines{
+      {"ecmascript",           [&](string_view in){ return count<cregex_iterator>(in,ecmascript); }},
+      {"ecmascript+optimize",  [&](string_view in){ return count<cregex_iterator>(in,optimized); }},
+      {"extended",             [&](string_view in){ return count<cregex_iterator>(in,extended); }},
+      {"ecmascript/tokens",    [&](string_view in){ return count<cregex_token_iterator>(in,ecmascript,vector<int>{1,2})/2; }},
+      {"scanner",              [](string_view in){ const scan::links l{in}; return size_t(distance(l.begin(),l.end())); }},
+      {"push_parser",          [](string_view in){
+         size_t n{0};
+         stream::link_parser parser{64*1024};
+         for(size_t i=0; i<in.size(); i+=4096)
+            parser.feed(in.substr(i,4096),[&n](string_view, string_view){ ++n; });
+         parser.finish([&n](string_view, string_view){ ++n; });
+         return n;
+      }},
+   };
+
+   cout << "engine\tmib\tdensity\tlinks\tseconds\tgb_per_s\tallocations\tpeak_heap" << endl;
+   for(size_t mib=1; mib<=megabytes; mib*=4)
+      for(const size_t density: {2,8,32}) {
+         const auto in = corpus(mib<<20,density);
+         size_t expected{0};
+         for(const auto& e: engines) {
+            size_t n{0};
+            const auto base = heap.load();
+            peak = base;
+            const auto before = allocations.load();
+            const auto t = measure([&]{ n = e.links(in); });
+            const auto a = allocations.load()-before;
+            if(&e==&engines.front())
+               expected = n;
+            else if(n!=expected) {
+               cerr << e.name << " found " << n << " links instead of " << expected << " in " << mib << " MiB, density " << density << endl;
+               return 2;
+            }
+            cout << e.name << '\t' << mib << '\t' << density << '\t' << n << '\t' << fixed << setprecision(6) << t << '\t'
+                 << setprecision(4) << double(in.size())/(1<<30)/t << '\t' << a << '\t' << peak.load()-base << defaultfloat << endl;
+         }
+      }
+   return 0;
+}
+
+int main(int argc, char *argv[])
+{
+   if(argc>1 && string_view{argv[1]}=="--suite")
+      return verify()? suite(argc>2? stoul(argv[2]) : 16) : 2;
+
+   const size_t megabytes = argc>1? stoul(argv[1]) : 64;
+   const size_t jobs      = argc>2? stoul(argv[2]) : max(1u,thread::hardware_concurrency());
+   if(!verify())
+      return 2;
+
+   const auto in = corpus(megabytes<<20,8);
+   matches r, s;
+   const auto tr = measure([&]{ r = by_regex(in); });
+   const auto ts = measure([&]{ s = by_scanner(in); });
+   if(!same(r,s) || !same(r,in_parallel(in,jobs,4096)) || !same_text(s,pushed(in,64*1024))) {
+      cout << "mismatch on the corpus" << endl;
+      return 2;
+   }
+   {
+      size_t n{0}, bytes{0};
+      const auto a = allocated([&]{
+         for(const auto& [match,href,text]: scan::links{in})
+            ++n, bytes += href.size()+text.size();
+      });
+      if(a!=0 || n!=s.size()) {
+         cout << "scan::links allocated " << a << " times over " << n << " links" << endl;
+         return 2;
+      }
+   }
+   const auto gb = double(in.size())/(1<<30);
+   cout << "corpus: " << megabytes << " MiB, " << s.size() << " links, the same matches" << endl;
+   {
+      const auto small = in.substr(0,in.size()/8);
+      size_t n{0};
+      const auto a = allocated([&]{
+         for(cregex_iterator it{small.data(),small.data()+small.size(),reg}; it!=cregex_iterator{}; ++it)
+            ++n;
+      });
+      cout << "allocations per match: sregex_iterator " << double(a)/max<size_t>(n,1) << ", scan::links 0" << endl;
+   }
+   cout << "sregex_iterator: " << gb/tr << " GB/s" << endl;
+   cout << "scanner:         " << gb/ts << " GB/s (" << tr/ts << "x)" << endl;
+   {
+      const auto small = in.substr(0,in.size()/8);
+      const patterns::pattern_set set{pattern_list};
+      size_t n{0};
+      const auto tset = measure([&]{ set.scan(small.data(),small.data()+small.size(),[&n](size_t, const cmatch&){ ++n; }); });
+      const auto tpass = measure([&]{
+         for(const auto& [text,flags]: pattern_list)
+            for(cregex_iterator it{small.data(),small.data()+small.size(),*patterns::compiled(text,flags)}; it!=cregex_iterator{}; ++it)
+               ;
+      });
+      cout << pattern_list.size() << " patterns, single pass: " << double(small.size())/(1<<30)/tset << " GB/s, "
+           << "a pass per pattern: " << double(small.size())/(1<<30)/tpass << " GB/s (" << n << " matches)" << endl;
+   }
+   {
+      size_t n{0};
+      stream::link_parser parser{64*1024};
+      const auto tpush = measure([&]{
+         for(size_t i=0; i<in.size(); i+=4096)
+            parser.feed(string_view{in}.substr(i,4096),[&n](string_view, string_view){ ++n; });
+         parser.finish([&n](string_view, string_view){ ++n; });
+      });
+      cout << "push parser, 4 KiB chunks: " << gb/tpush << " GB/s (" << n << " links)" << endl;
+   }
+   {
+      string buffer;
+      size_t plain{0};
+      const auto tclean = measure([&]{
+         for(const auto& [href,text]: s)
+            plain += text::clean(text,buffer).data()==text.data();
+      });
+      bool all_plain{false};
+      const auto tplain = measure([&]{ all_plain = text::plain(in); });
+      if(!all_plain || plain!=s.size()) {
+         cout << "the plain corpus is not plain" << endl;
+         return 2;
+      }
+      // a reference or a non ASCII letter every 64 bytes or so
+      string mixed;
+      mixed.reserve(in.size()+in.size()/16);
+      for(size_t i=0; i<in.size(); i+=64)
+         mixed.append(in,i,64).append(0==i%128? "&amp;" : "caf\xC3\xA9");
+      text::clean(mixed,buffer);
+      const auto tmixed = measure([&]{ text::clean(mixed,buffer); });
+      cout << "clean-up: " << tclean*1e9/s.size() << " ns per link text, "
+           << "the plain corpus " << gb/tplain << " GB/s, with references and UTF-8 " << double(mixed.size())/(1<<30)/tmixed << " GB/s" << endl;
+   }
+   {
+      const auto l = links(2'000'000,2'000,100);
+      size_t bytes{0};
+      urls::index index;
+      string buffer;
+      const auto tindex = measure([&]{
+         for(const auto& url: l)
+            index.add(urls::normalize(url,buffer));
+      });
+      index.for_each([&bytes](string_view url, uint32_t){ bytes += url.size(); });
+      cout << "unique links: " << index.size() << " of " << l.size() << ", " << tindex*1e9/l.size() << " ns per link, "
+           << double(index.memory())/index.size() << " bytes per unique link of " << double(bytes)/index.size() << " on average" << endl;
+   }
+   for(size_t j=1; j<=jobs; j*=2) {
+      matches p;
+      const auto tp = measure([&]{ p = in_parallel(in,j,1<<20); });
+      cout << "scanner, jobs=" << j << ": " << gb/tp << " GB/s (" << ts/tp << "x)" << endl;
+   }
+}
@@ -0,0 +1,135 @@
+#ifndef REGEX_INPUT_H_
+#define REGEX_INPUT_H_
+
+#include <cerrno>
+#include <cstddef>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <system_error>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+/**
+   Input of the link extractor without copies.
+
+   A regular file is mapped read-only and matched in place, results are 'string_view's into the mapping.
+   Pages which have been scanned are handed back to the kernel ('release'), so the resident memory of a huge input
+   does not grow with its size.
+   Pipes, terminals and anything else that can't be mapped are read by fixed chunks into one buffer instead,
+   the unmatched tail of a chunk (at most 'overlap' bytes) is carried over to the next one.
+
+   \see https://man7.org/linux/man-pages/man2/mmap.2.html
+*/
+
+namespace input
+{
+
+class mapped_file
+{
+public:
+   /**
+      \retval false if 'fd' is not a regular file or cannot be mapped
+   */
+   bool map(int fd)
+   {
+      struct stat st;
+      if(0!=::fstat(fd,&st) || !S_ISREG(st.st_mode))
+         return false;
+      if(0==st.st_size)
+         return true;
+      void* p = ::mmap(nullptr,st.st_size,PROT_READ,MAP_PRIVATE,fd,0);
+      if(MAP_FAILED==p)
+         return false;
+      ::madvise(p,st.st_size,MADV_SEQUENTIAL);
+      data_ = static_cast<const char*>(p);
+      size_ = st.st_size;
+      return true;
+   }
+
+   mapped_file() = default;
+   ~mapped_file()
+   {
+      if(data_)
+         ::munmap(const_cast<char*>(data_),size_);
+   }
+
+   mapped_file(const mapped_file&) = delete;
+   mapped_file& operator=(const mapped_file&) = delete;
+
+   std::string_view view() const noexcept { return {data_,size_}; }
+
+   /**
+      Drops the pages before 'upto' from the resident memory, they are not going to be read again.
+      The content stays available, touching a released page reads it in again.
+   */
+   void release(const char* upto) noexcept
+   {
+      static const std::size_t page = ::sysconf(_SC_PAGESIZE);
+      const std::size_t end = (upto-data_)/page*page;
+      if(end<=released_)
+         return;
+      ::madvise(const_cast<char*>(data_)+released_,end-released_,MADV_DONTNEED);
+      released_ = end;
+   }
+
+private:
+   const char* data_{nullptr};
+   std::size_t size_{0};
+   std::size_t released_{0};
+};
+
+class chunked_reader
+{
+public:
+   static constexpr std::size_t chunk_size{1<<20};
+
+   /**
+      \param 'overlap' is the longest tail carried over to the next chunk, i.e. the longest match found across chunks
+   */
+   chunked_reader(int fd, std::size_t overlap)
+      :  fd_(fd)
+        ,overlap_(overlap)
+        ,buffer_(new char[overlap+chunk_size])
+   {}
+
+   /**
+      Calls scan(window,last) for every chunk, where the window is the carried over tail followed by the new chunk
+      and 'last' tells this is the end of input. 'scan' returns the number of bytes of the window it is done with.
+      The window is valid during the call only.
+   */
+   template <typename Scan>
+   void run(Scan scan)
+   {
+      std::size_t kept{0};
+      for(;;) {
+         const auto n = ::read(fd_,buffer_.get()+kept,chunk_size);
+         if(n<0) {
+            if(EINTR==errno)
+               continue;
+            throw std::system_error{errno,std::generic_category(),"read"};
+         }
+         const std::size_t size = kept+n;
+         std::size_t done = scan(std::string_view{buffer_.get(),size},0==n);
+         if(0==n)
+            return;
+         if(size-done>overlap_)
+            done = size-overlap_;
+         kept = size-done;
+         std::memmove(buffer_.get(),buffer_.get()+done,kept);
+      }
+   }
+
+private:
+   const int               fd_;
+   const std::size_t       overlap_;
+   std::unique_ptr<char[]> buffer_;
+};
+
+}  // end of namespace input
+
+#endif // REGEX_INPUT_H_
@@ -1,41 +1,198 @@
 #include <string>
+#include <string_view>
 #include <regex>
 #include <iostream>
-#include <fstream>
-#include <sstream>
 #include <iterator>
+#include <iomanip>
+#include <thread>
+#include <fstream>
+#include <vector>
+
+#include "input.h"
+#include "scanner.h"
+#include "parallel.h"
+#include "patterns.h"
+#include "stream.h"
+#include "text.h"
+#include "urls.h"
 
 using namespace std;
 
-string read() {
-   stringstream ss;
-   ss << ifstream{"Regular expressions library - cppreference.com.html"}.rdbuf();
-   return ss.str();
+/**
+   Expected pattern: <a href="url" ... >text ...</a>
+   \see https://en.cppreference.com/w/cpp/regex/ecmascript
+*/
+const regex reg{"<a href=\"([^\"]*)\"[^<]*>([^<]*)</a>"};
+//                         link             dest
+
+/**
+   A match longer than this is not found across the chunks of a stream.
+*/
+constexpr size_t max_match{64*1024};
+
+string_view view(const csub_match& m)
+{
+   return {m.first,static_cast<size_t>(m.length())};
 }
 
-int main()
+/**
+   Calls emit(link,dest) for every match in 'in', the views point into 'in'.
+   \retval the end of the last match, i.e. where the part of 'in' which is done with ends
+*/
+template <typename Emit>
+const char* extract(string_view in, Emit emit)
+{  // variant 1
+   const char* done = in.data();
+   cregex_iterator it{in.data(), in.data()+in.size(), reg};
+   for (; it != cregex_iterator{}; ++it) {
+      emit(view((*it)[1]), view((*it)[2]));
+      done = (*it)[0].second;
+   }
+   return done;
+}
+
+/**
+   The regex engine for the parallel extraction.
+*/
+bool regex_next(const char* p, const char* end, scan::anchor& m)
 {
-   auto const in = read();
-
-   /**
-      Expected pattern: <a href="url" ... >text ...</a>
-      \see https://en.cppreference.com/w/cpp/regex/ecmascript
-   */
-   const regex reg{"<a href=\"([^\"]*)\"[^<]*>([^<]*)</a>"};
-   //                         link             dest
-   {  // variant 1
-      sregex_iterator it{begin(in), end(in), reg};      
-		for (; it != sregex_iterator{}; ++it)
-         cout << it->str(2) << ":\t" << it->str(1) << endl;   
+   cmatch r;
+   if (!regex_search(p, end, r, reg))
+      return false;
+   m.match = view(r[0]);
+   m.href = view(r[1]);
+   m.text = view(r[2]);
+   return true;
+}
+
+template <typename Emit>
+void extract_tokens(string_view in, Emit emit)
+{  // variant 2
+   cregex_token_iterator it{in.data(), in.data()+in.size(), reg, {1,2}};
+   while (it != cregex_token_iterator{}) {
+      const auto link = view(*it++);
+      const auto dest = view(*it++);
+      emit(link, dest);
    }
+}
 
-   {  // variant 2
-      sregex_token_iterator it{begin(in), end(in), reg, {1,2}};      
-		while (it != sregex_token_iterator{}) {
-         const string link{*it++};
-         const string dest{*it++};
-         cout << dest << ":\t" << link << endl;
+int main(int argc, char *argv[])
+{
+   string path{"Regular expressions library - cppreference.com.html"};
+   bool tokens{false};
+   bool decode{false};         // validated UTF-8, character references decoded
+   bool unique{false};         // normalized links with their counts
+   string engine{"scanner"};   // hand-built automaton, or "regex"
+   size_t jobs{1};             // threads over a mapped file
+   vector<pair<string,patterns::flags>> list;   // of patterns to match instead of links, tagged by their index
+   auto flags = regex::ECMAScript;
+   for(int i=1; i<argc; ++i) {
+      const string arg{argv[i]};
+      if(arg=="--tokens")
+         tokens = true;
+      else if(arg=="--engine" && i+1<argc)
+         engine = argv[++i];
+      else if(arg=="--jobs" && i+1<argc)
+         jobs = strtoul(argv[++i],nullptr,10);
+      else if(arg=="--decode")
+         decode = true;
+      else if(arg=="--unique")
+         unique = true;
+      else if(arg=="--icase")
+         flags |= regex::icase;
+      else if(arg=="--pattern" && i+1<argc)
+         list.emplace_back(argv[++i],flags);
+      else if(arg=="--patterns" && i+1<argc) {
+         ifstream is{argv[++i]};
+         for(string line; getline(is,line);)
+            if(!line.empty())
+               list.emplace_back(line,flags);
       }
+      else if(arg.rfind("--",0)!=0)
+         path = arg;
+      else
+         engine.clear();
+   }
+   if((engine!="scanner" && engine!="regex") || (tokens && (engine!="regex" || jobs!=1)) || 0==jobs || (!list.empty() && (tokens || jobs!=1 || unique))) {
+      cout  << "Usage: " << argv[0] << " [--engine scanner|regex] [--jobs N] [--decode] [--unique] [<file>|-]" << endl
+            << "       " << argv[0] << " --engine regex --tokens [--decode] [--unique] [<file>|-]" << endl
+            << "       " << argv[0] << " [--icase] (--pattern <regex> | --patterns <file of regex per line>)... <file>" << endl;
+      return 1;
+   }
+   const bool scanner = engine=="scanner";
+
+   const int fd = path=="-"? STDIN_FILENO : ::open(path.c_str(),O_RDONLY|O_CLOEXEC);
+   if(fd<0) {
+      cout << "cannot open " << quoted(path) << endl;
+      return 2;
    }
-}
 
+   ios::sync_with_stdio(false);
+   string link_buffer, dest_buffer, url_buffer;
+   urls::index links;
+   const auto print = [&](string_view link, string_view dest) {
+      if(unique) {   // the href is an attribute, its references are always decoded
+         const auto url = urls::normalize(text::clean(link, link_buffer), url_buffer);
+         if(!url.empty())   // not a fragment of the same page only
+            links.add(url);
+         return;
+      }
+      if(decode) {
+         link = text::clean(link, link_buffer);
+         dest = text::clean(dest, dest_buffer);
+      }
+      cout << dest << ":\t" << link << '\n';
+   };
+   try {
+      input::mapped_file file;
+      if(!list.empty()) {  // tagged matches of a pattern set
+         if(!file.map(fd))
+            throw runtime_error{"patterns are matched over a regular file only"};
+         const patterns::pattern_set set{list};
+         const auto in = file.view();
+         set.scan(in.data(), in.data()+in.size(), [](size_t pattern, const cmatch& m) {
+            cout << pattern << ":\t" << view(m[0]) << '\n';
+         });
+      }
+      else if(file.map(fd)) {   // zero copy: matched in place
+         const auto emit = [&](string_view link, string_view dest) {
+            print(link, dest);
+            file.release(link.data());
+         };
+         if(jobs>1 && scanner)
+            parallel::extract(file.view(), jobs, scan::next, emit);
+         else if(jobs>1)
+            parallel::extract(file.view(), jobs, regex_next, emit);
+         else if(scanner)
+            for (const auto& [match, link, dest]: scan::links{file.view()})
+               emit(link, dest);
+         else if(tokens)
+            extract_tokens(file.view(), emit);
+         else
+            extract(file.view(), emit);
+      }
+      else if(scanner) {   // pipe: pushed through the incremental parser, only the tag in progress is kept
+         stream::link_parser parser{max_match};
+         input::chunked_reader{fd,0}.run([&](string_view chunk, bool last) {
+            parser.feed(chunk, print);
+            if(last)
+               parser.finish(print);
+            return chunk.size();
+         });
+      }
+      else                 // pipe: by chunks, variant 1 only as it tells where the last match ends
+         input::chunked_reader{fd,max_match}.run([&](string_view window, bool) {
+            const auto* done = extract(window, print);
+            return static_cast<size_t>(done-window.data());
+         });
+   }
+   catch(const exception& e) {
+      cout << e.what() << endl;
+      return 2;
+   }
+   links.for_each([](string_view url, uint32_t count) {
+      cout << count << '\t' << url << '\n';
+   });
+   cout.flush();
+   return 0;
+}
@@ -0,0 +1,127 @@
+#ifndef REGEX_PARALLEL_H_
+#define REGEX_PARALLEL_H_
+
+#include "scanner.h"
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+/**
+   Parallel extraction over an input in memory (a mapped file), with the same matches in the same order as a sequential scan.
+
+   The input is split into chunks, a pool of threads takes them one by one and collects the matches which *start* in its chunk;
+   a match may run past the end of the chunk, up to 'overlap' bytes, so a link straddling a boundary is found by the chunk it begins in.
+   The results are merged in input order as soon as the next chunk is ready, while the others are still being scanned.
+
+   Stitching: the sequential scan resumes after the end of the previous match, a chunk started at its own boundary instead.
+   Whether a match starts at some position does not depend on where the search has started, so both agree as soon as
+   the previous match of the chunk ended before the point the sequential scan resumes at. Only when a match straddling the boundary
+   overlaps a different one found by the chunk, the overlap window is re-scanned from the end of the straddling match
+   until it meets a match of the chunk again.
+   A match longer than 'overlap' across a boundary is not found, the same limit as of the chunked reader of a stream.
+*/
+
+namespace parallel
+{
+
+constexpr std::size_t default_chunk{16<<20};
+constexpr std::size_t default_overlap{64*1024};
+
+/**
+   Calls emit(href,text) for every match in 'in', in input order.
+   \param 'next' is the engine: bool next(const char* p, const char* end, scan::anchor& m) finds the leftmost match in [p,end)
+*/
+template <typename Next, typename Emit>
+void extract(std::string_view in, std::size_t jobs, Next next, Emit emit,
+             std::size_t chunk = default_chunk, std::size_t overlap = default_overlap)
+{
+   const char* const begin = in.data();
+   chunk = std::max<std::size_t>(chunk,1);
+   const std::size_t chunks = std::max<std::size_t>((in.size()+chunk-1)/chunk,1);
+   const auto boundary = [&](std::size_t i) { return begin+std::min(i*chunk,in.size()); };
+   const auto limit = [&](std::size_t i) { return begin+std::min((i+1)*chunk+overlap,in.size()); };
+
+   std::vector<std::vector<scan::anchor>> results(chunks);
+   std::unique_ptr<bool[]> ready{new bool[chunks]()};
+   std::mutex m;
+   std::condition_variable cv;
+   std::atomic<std::size_t> taken{0};
+   std::atomic<bool> stop{false};
+   std::exception_ptr error;
+
+   const auto work = [&]{
+      for(auto i=taken++; i<chunks && !stop; i=taken++) {
+         std::vector<scan::anchor> r;
+         try {
+            scan::anchor a;
+            for(const char* p = boundary(i); next(p,limit(i),a) && a.match.data()<boundary(i+1); p = a.match.data()+a.match.size())
+               r.push_back(a);
+         }
+         catch(...) {
+            std::lock_guard lock{m};
+            if(!error)
+               error = std::current_exception();
+            stop = true;
+         }
+         std::lock_guard lock{m};
+         results[i] = std::move(r);
+         ready[i] = true;
+         cv.notify_all();
+      }
+   };
+   std::vector<std::thread> threads;
+   for(std::size_t i=0; i<std::min(std::max<std::size_t>(jobs,1),chunks); ++i)
+      threads.emplace_back(work);
+
+   const char* resume = begin;   // end of the last match emitted
+   const auto accept = [&](const scan::anchor& a) {
+      emit(a.href,a.text);
+      resume = a.match.data()+a.match.size();
+   };
+   for(std::size_t i=0; i<chunks && !stop; ++i) {
+      {
+         std::unique_lock lock{m};
+         cv.wait(lock,[&]{ return ready[i] || stop; });
+      }
+      if(stop)
+         break;
+      auto r = std::move(results[i]);
+      std::size_t j{0};
+      while(j<r.size() && r[j].match.data()<resume)
+         ++j;
+      // the chunk agrees with the sequential scan unless the match before 'j' runs past 'resume'
+      if(j>0 && r[j-1].match.data()+r[j-1].match.size()>resume) {
+         bool synchronized{false};
+         scan::anchor a;
+         while(!synchronized && next(resume,limit(i),a) && a.match.data()<boundary(i+1)) {
+            while(j<r.size() && r[j].match.data()<a.match.data())
+               ++j;
+            synchronized = j<r.size() && r[j].match.data()==a.match.data();
+            if(!synchronized)
+               accept(a);
+         }
+         if(!synchronized)   // nothing of the chunk is left after the re-scanned matches
+            j = r.size();
+      }
+      for(; j<r.size(); ++j)
+         accept(r[j]);
+   }
+
+   stop = true;
+   for(auto& t: threads)
+      t.join();
+   if(error)
+      std::rethrow_exception(error);
+}
+
+}  // end of namespace parallel
+
+#endif // REGEX_PARALLEL_H_
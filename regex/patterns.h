@@ -0,0 +1,275 @@
+#ifndef REGEX_PATTERNS_H_
+#define REGEX_PATTERNS_H_
+
+#include <algorithm>
+#include <array>
+#include <cctype>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <regex>
+#include <string>
+#include <string_view>
+#include <tuple>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+/**
+   A set of extraction patterns matched over a document in a single pass.
+
+   Compiling a 'std::regex' is expensive, so compiled patterns are kept in a cache keyed by the pattern text and its flags
+   and shared by all sets which use them.
+   Most extraction patterns begin with a literal ('<a href="', 'src="', 'http://'). Those literal prefixes of all patterns are put
+   into one Aho-Corasick automaton, which finds every candidate position in one pass over the input (ASCII case folded,
+   so case insensitive patterns are prefiltered too); only there the pattern is verified by the regex, anchored at the candidate.
+   A pattern without a literal prefix can't be prefiltered, it gets a regular 'regex_search' pass of its own;
+   so does a pattern of a POSIX grammar, the prefix is read by the ECMAScript syntax only.
+
+   For every pattern the matches are the same as of its own 'sregex_iterator' (leftmost, non-overlapping),
+   the matches of all patterns are reported ordered by their position, then by the index of the pattern.
+
+   \see https://en.wikipedia.org/wiki/Aho%E2%80%93Corasick_algorithm
+*/
+
+namespace patterns
+{
+
+using flags = std::regex_constants::syntax_option_type;
+
+/**
+   \retval the compiled pattern, compiled on the first request only
+*/
+inline std::shared_ptr<const std::regex> compiled(const std::string& text, flags f = std::regex::ECMAScript)
+{
+   struct key_hash
+   {
+      std::size_t operator()(const std::pair<std::string,unsigned>& k) const noexcept
+      {
+         return std::hash<std::string>{}(k.first) ^ (std::size_t{k.second}*0x9E3779B97F4A7C15ull);
+      }
+   };
+   static std::mutex m;
+   static std::unordered_map<std::pair<std::string,unsigned>,std::shared_ptr<const std::regex>,key_hash> cache;
+
+   const std::pair<std::string,unsigned> key{text,static_cast<unsigned>(f)};
+   std::lock_guard lock{m};
+   auto& r = cache[key];
+   if(!r)
+      r = std::make_shared<const std::regex>(text,f);
+   return r;
+}
+
+inline bool ecmascript(flags f) noexcept
+{
+   using namespace std::regex_constants;
+   return !(f & (basic|extended|awk|grep|egrep));
+}
+
+/**
+   The literal every match of an ECMAScript pattern begins with, empty if there is none.
+*/
+inline std::string literal_prefix(std::string_view p)
+{
+   // an alternative anywhere makes the prefix optional
+   for(std::size_t i=0, depth=0; i<p.size(); ++i)
+      if('\\'==p[i])
+         ++i;
+      else if('['==p[i])
+         ++depth;
+      else if(']'==p[i] && depth)
+         --depth;
+      else if('|'==p[i] && !depth)
+         return {};
+
+   std::string prefix;
+   for(std::size_t i=0; i<p.size(); ++i) {
+      char c = p[i];
+      std::size_t next = i+1;
+      if('\\'==c) {
+         if(i+1==p.size())
+            break;
+         c = p[i+1];
+         next = i+2;
+         if(std::isalnum(static_cast<unsigned char>(c)))   // \d \w \b \1 ... are not literals
+            break;
+      }
+      else if(std::string_view{"^$.|?*+()[]{}"}.find(c)!=std::string_view::npos)
+         break;
+      if(next<p.size() && std::string_view{"?*+{"}.find(p[next])!=std::string_view::npos)
+         break;                                          // the char is optional or repeated
+      prefix += c;
+      i = next-1;
+   }
+   return prefix;
+}
+
+/**
+   Dense Aho-Corasick automaton over ASCII case folded bytes.
+*/
+class aho_corasick
+{
+public:
+   aho_corasick() : next_(1), out_(1) { next_[0].fill(0); }
+
+   static unsigned char fold(unsigned char c) noexcept { return ('A'<=c && c<='Z')? c+('a'-'A') : c; }
+
+   void add(std::string_view literal, std::uint32_t id)
+   {
+      std::uint32_t s{0};
+      for(const unsigned char c: literal) {
+         auto t = next_[s][fold(c)];
+         if(!t) {   // not a reference into 'next_', it grows
+            t = next_[s][fold(c)] = static_cast<std::uint32_t>(next_.size());
+            next_.emplace_back().fill(0);
+            out_.emplace_back();
+         }
+         s = t;
+      }
+      out_[s].push_back(id);
+   }
+
+   /**
+      Turns the trie into the automaton: missing transitions follow the failure links, outputs include those of the suffixes.
+   */
+   void build()
+   {
+      std::vector<std::uint32_t> fail(next_.size(),0);
+      std::deque<std::uint32_t> q;
+      for(unsigned c=0; c<256; ++c)
+         if(next_[0][c])
+            q.push_back(next_[0][c]);
+      while(!q.empty()) {
+         const auto s = q.front();
+         q.pop_front();
+         out_[s].insert(out_[s].end(),out_[fail[s]].begin(),out_[fail[s]].end());
+         for(unsigned c=0; c<256; ++c) {
+            auto& t = next_[s][c];
+            if(t) {
+               fail[t] = next_[fail[s]][c];
+               q.push_back(t);
+            }
+            else
+               t = next_[fail[s]][c];
+         }
+      }
+   }
+
+   /**
+      Calls f(id,end) for every occurrence of every literal, 'end' is the position past it.
+   */
+   template <typename F>
+   void scan(const char* p, const char* end, F f) const
+   {
+      std::uint32_t s{0};
+      for(; p!=end; ++p) {
+         s = next_[s][fold(static_cast<unsigned char>(*p))];
+         for(const auto id: out_[s])
+            f(id,p+1);
+      }
+   }
+
+private:
+   std::vector<std::array<std::uint32_t,256>> next_;
+   std::vector<std::vector<std::uint32_t>>    out_;
+};
+
+class pattern_set
+{
+public:
+   pattern_set(const std::vector<std::pair<std::string,flags>>& list)
+   {
+      for(const auto& [text,f]: list) {
+         entry e{compiled(text,f),ecmascript(f)? literal_prefix(text) : std::string{}};
+         const bool ascii = std::all_of(e.prefix.begin(),e.prefix.end(),[](char c){ return static_cast<unsigned char>(c)<0x80; });
+         if(!e.prefix.empty() && (ascii || !(f & std::regex::icase))) {
+            ac_.add(e.prefix,static_cast<std::uint32_t>(entries_.size()));
+            longest_ = std::max(longest_,e.prefix.size());
+         }
+         else
+            e.prefix.clear();
+         entries_.push_back(std::move(e));
+      }
+      ac_.build();
+   }
+
+   std::size_t size() const noexcept { return entries_.size(); }
+   bool filtered(std::size_t i) const noexcept { return !entries_[i].prefix.empty(); }
+
+   /**
+      Calls emit(pattern,match) for the matches of all patterns in [begin,end).
+   */
+   template <typename Emit>
+   void scan(const char* begin, const char* end, Emit emit) const
+   {
+      struct candidate
+      {
+         const char*    start;
+         std::uint32_t  pattern;
+         bool operator>(const candidate& o) const noexcept { return std::tie(start,pattern)>std::tie(o.start,o.pattern); }
+      };
+      std::priority_queue<candidate,std::vector<candidate>,std::greater<candidate>> pending;
+      std::vector<const char*> resume(entries_.size(),begin);   // end of the last match of every pattern
+      std::cmatch m;
+
+      // patterns without a prefix: their own iterators, merged by position
+      std::vector<std::cregex_iterator> others(entries_.size());
+      for(std::size_t i=0; i<entries_.size(); ++i)
+         if(!filtered(i))
+            others[i] = std::cregex_iterator{begin,end,*entries_[i].re};
+      const auto flush_others = [&](const char* upto, std::uint32_t pattern) {
+         for(bool found=true; found;) {
+            found = false;
+            std::size_t best{0};
+            for(std::size_t i=0; i<others.size(); ++i)
+               if(!filtered(i) && std::cregex_iterator{}!=others[i]
+                  && (!found || (*others[i])[0].first<(*others[best])[0].first))
+                  best = i, found = true;
+            if(!found || (*others[best])[0].first>upto || ((*others[best])[0].first==upto && best>pattern))
+               return;
+            emit(best,*others[best]);
+            ++others[best];
+         }
+      };
+
+      const auto verify = [&](const candidate& c) {
+         flush_others(c.start,c.pattern);
+         if(c.start<resume[c.pattern])
+            return;
+         const auto f = c.start==begin? std::regex_constants::match_continuous
+                                      : std::regex_constants::match_continuous|std::regex_constants::match_prev_avail;
+         if(!std::regex_search(c.start,end,m,*entries_[c.pattern].re,f))
+            return;
+         emit(c.pattern,m);
+         resume[c.pattern] = m[0].second+(0==m.length(0));
+      };
+
+      ac_.scan(begin,end,[&](std::uint32_t pattern, const char* e) {
+         pending.push({e-entries_[pattern].prefix.size(),pattern});
+         // no candidate found later can start before this point
+         for(; !pending.empty() && pending.top().start+longest_<e; pending.pop())
+            verify(pending.top());
+      });
+      for(; !pending.empty(); pending.pop())
+         verify(pending.top());
+      flush_others(end,static_cast<std::uint32_t>(entries_.size()));
+   }
+
+private:
+   struct entry
+   {
+      std::shared_ptr<const std::regex>   re;
+      std::string                         prefix;   // empty if not prefiltered
+   };
+
+   std::vector<entry>   entries_;
+   aho_corasick         ac_;
+   std::size_t          longest_{0};
+};
+
+}  // end of namespace patterns
+
+#endif // REGEX_PATTERNS_H_
@@ -0,0 +1,192 @@
+#ifndef REGEX_SCANNER_H_
+#define REGEX_SCANNER_H_
+
+#include <cstddef>
+#include <cstring>
+#include <iterator>
+#include <string_view>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+/**
+   Hand-built scanner of the anchor pattern, a replacement of 'std::regex' for
+      <a href="([^"]*)"[^<]*>([^<]*)</a>
+   with exactly the same matches as 'sregex_iterator' gives (ECMAScript, leftmost, greedy with backtracking).
+
+   The pattern compiles down to a deterministic automaton whose states are separated by single bytes:
+      open   : the literal '<a href="'
+      href   : [^"]*   until '"'            -> group 1
+      attrs  : [^<]*   until '<', the last '>' seen splits attrs from the text
+      text   :                              -> group 2, from past that '>' up to the '<'
+      close  : the literal '</a>' at that '<', otherwise no match at this start
+   Backtracking can't find anything else: both groups are bounded by the first '"' and the first '<' after them,
+   and the greedy '[^<]*>' settles on the last '>' before that '<'.
+   Every state loops over "any byte but one", which is a 'memchr' (vectorized by the C library),
+   and candidates of 'open' are found by a SIMD search of the pair '<a' 16 bytes at a time.
+   A failed candidate costs only the bytes up to the next '"' or '<'.
+*/
+
+namespace scan
+{
+
+struct anchor
+{
+   std::string_view  match;   // whole
+   std::string_view  href;    // group 1
+   std::string_view  text;    // group 2
+};
+
+constexpr std::string_view open{"<a href=\""};
+constexpr std::string_view close{"</a>"};
+
+/**
+   \retval the first position of '<a' in [p,end), 'end' if there is none
+*/
+inline const char* find_open(const char* p, const char* end) noexcept
+{
+#ifdef __SSE2__
+   const auto lt = _mm_set1_epi8(open[0]);
+   const auto a = _mm_set1_epi8(open[1]);
+   for(; end-p>16; p+=16) {
+      const auto x = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+      const auto y = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p+1));
+      const unsigned m = _mm_movemask_epi8(_mm_and_si128(_mm_cmpeq_epi8(x,lt),_mm_cmpeq_epi8(y,a)));
+      if(m)
+         return p+__builtin_ctz(m);
+   }
+#endif
+   for(; end-p>1; ++p)
+      if(open[0]==p[0] && open[1]==p[1])
+         return p;
+   return end;
+}
+
+inline const char* find(const char* p, const char* end, char c) noexcept
+{
+   const auto* r = static_cast<const char*>(std::memchr(p,c,end-p));
+   return r? r : end;
+}
+
+inline const char* find_last(const char* p, const char* end, char c) noexcept
+{
+   for(; end!=p; --end)
+      if(c==end[-1])
+         return end-1;
+   return nullptr;
+}
+
+/**
+   Tries the automaton at 'p', which is known to start with '<a'.
+   \retval true and the match in 'm' on success
+*/
+inline bool match_at(const char* p, const char* end, anchor& m) noexcept
+{
+   if(std::size_t(end-p)<open.size() || 0!=std::memcmp(p,open.data(),open.size()))
+      return false;
+   const char* href = p+open.size();
+   const char* quote = find(href,end,'"');
+   if(end==quote)
+      return false;
+   const char* lt = find(quote+1,end,'<');
+   if(std::size_t(end-lt)<close.size() || 0!=std::memcmp(lt,close.data(),close.size()))
+      return false;
+   const char* gt = find_last(quote+1,lt,'>');
+   if(!gt)
+      return false;
+   m.match = {p,std::size_t(lt+close.size()-p)};
+   m.href = {href,std::size_t(quote-href)};
+   m.text = {gt+1,std::size_t(lt-gt-1)};
+   return true;
+}
+
+/**
+   \retval true and the leftmost match in [p,end) in 'm'
+*/
+inline bool next(const char* p, const char* end, anchor& m) noexcept
+{
+   for(p = find_open(p,end); end!=p; p = find_open(p+1,end))
+      if(match_at(p,end,m))
+         return true;
+   return false;
+}
+
+/**
+   Lazy input iterator over the matches, every one is a set of views into the input: nothing is copied or allocated.
+*/
+class link_iterator
+{
+public:
+   using iterator_category = std::input_iterator_tag;
+   using value_type        = anchor;
+   using difference_type   = std::ptrdiff_t;
+   using pointer           = const anchor*;
+   using reference         = const anchor&;
+
+   link_iterator() noexcept = default;   // the end
+   link_iterator(const char* p, const char* end) noexcept : end_(end) { find(p); }
+
+   reference operator*() const noexcept { return m_; }
+   pointer operator->() const noexcept { return &m_; }
+
+   link_iterator& operator++() noexcept
+   {
+      find(m_.match.data()+m_.match.size());
+      return *this;
+   }
+
+   link_iterator operator++(int) noexcept
+   {
+      auto tmp = *this;
+      ++*this;
+      return tmp;
+   }
+
+   friend bool operator==(const link_iterator& a, const link_iterator& b) noexcept { return a.m_.match.data()==b.m_.match.data(); }
+   friend bool operator!=(const link_iterator& a, const link_iterator& b) noexcept { return !(a==b); }
+
+private:
+   void find(const char* p) noexcept
+   {
+      if(!next(p,end_,m_))
+         m_ = {};
+   }
+
+   const char* end_{nullptr};
+   anchor      m_;
+};
+
+/**
+   The matches of 'in' as a range:
+      for(const auto& [match,href,text]: scan::links(in))
+*/
+class links
+{
+public:
+   explicit links(std::string_view in) noexcept : in_(in) {}
+
+   link_iterator begin() const noexcept { return {in_.data(),in_.data()+in_.size()}; }
+   link_iterator end() const noexcept { return {}; }
+
+private:
+   std::string_view in_;
+};
+
+/**
+   Calls emit(href,text) for every match in 'in', the views point into 'in'.
+   \retval the end of the last match, the same contract as of the regex 'extract'
+*/
+template <typename Emit>
+const char* extract(std::string_view in, Emit emit)
+{
+   const char* done = in.data();
+   const char* end = in.data()+in.size();
+   for(anchor m; next(done,end,m); done = m.match.data()+m.match.size())
+      emit(m.href,m.text);
+   return done;
+}
+
+}  // end of namespace scan
+
+#endif // REGEX_SCANNER_H_
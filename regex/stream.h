@@ -0,0 +1,172 @@
+#ifndef REGEX_STREAM_H_
+#define REGEX_STREAM_H_
+
+#include "scanner.h"
+
+#include <cstddef>
+#include <string>
+#include <string_view>
+#include <utility>
+
+/**
+   Push parser of the anchor pattern for endless streams: bytes come in chunks of any size, matches go out as soon as they complete.
+
+   It is the automaton of the scanner run one chunk at a time. Between chunks only the state and the bytes of the tag
+   in progress (from its '<' on) are kept, anything outside a candidate tag is skipped without a copy.
+   A candidate which fails is scanned again from its second byte, the same as the scanner resumes after a failed start,
+   so the matches are exactly those of 'scan::links' over the whole stream however it is split.
+   The memory is bounded by the longest tag: a candidate growing past 'max_tag' bytes is given up.
+*/
+
+namespace stream
+{
+
+class link_parser
+{
+public:
+   explicit link_parser(std::size_t max_tag) : max_tag_(max_tag) {}
+
+   /**
+      Calls emit(href,text) for every match completed by 'chunk'.
+      The views point into 'chunk' or into the parser, they are valid during the call only.
+   */
+   template <typename Emit>
+   void feed(std::string_view chunk, Emit emit)
+   {
+      const char* p = chunk.data();
+      const char* const end = p+chunk.size();
+      while(!replay_.empty() || p!=end) {
+         if(replay_.empty()) {
+            run(p,end,emit);
+            continue;
+         }
+         // bytes of a failed candidate go before the rest of the chunk
+         std::string r;
+         r.swap(replay_);
+         const char* q = r.data();
+         run(q,r.data()+r.size(),emit);
+         if(!replay_.empty())
+            replay_.append(q,r.data()+r.size()-q);
+      }
+   }
+
+   /**
+      The end of the stream: the tag in progress can't complete any more.
+   */
+   template <typename Emit>
+   void finish(Emit emit)
+   {
+      while(seek!=state_) {
+         fail();
+         feed({},emit);
+      }
+   }
+
+   std::size_t buffered() const noexcept { return buf_.size(); }
+
+private:
+   enum state_t { seek, open, href, attrs, close };
+
+   /**
+      Runs the automaton over [p,end) until the end or a failed candidate, 'p' is moved past the bytes consumed.
+   */
+   template <typename Emit>
+   void run(const char*& p, const char* end, Emit& emit)
+   {
+      while(p!=end) {
+         switch(state_) {
+         case seek: {
+            const char* lt = scan::find_open(p,end);
+            if(end==lt && scan::open[0]==end[-1])   // '<' at the end, maybe '<a' across chunks
+               lt = end-1;
+            if(end==lt) {
+               p = end;
+               break;
+            }
+            buf_.assign(1,*lt);
+            p = lt+1;
+            state_ = open;
+            break;
+         }
+         case open:
+         case close: {
+            const auto literal = open==state_? scan::open : scan::close;
+            for(; p!=end && buf_.size()-mark_<literal.size(); ++p) {
+               if(*p!=literal[buf_.size()-mark_])
+                  return fail();
+               buf_ += *p;
+            }
+            if(buf_.size()-mark_<literal.size())
+               break;
+            if(open==state_) {
+               state_ = href;
+               mark_ = buf_.size();
+            }
+            else if(!matched(emit))
+               return fail();
+            break;
+         }
+         case href:
+         case attrs: {
+            const char stop = href==state_? '"' : '<';
+            const char* q = scan::find(p,end,stop);
+            buf_.append(p,q-p);
+            p = q;
+            if(buf_.size()>max_tag_)
+               return fail();
+            if(end==q)
+               break;
+            buf_ += *p++;
+            if(href==state_) {
+               quote_ = buf_.size()-1;
+               state_ = attrs;
+            }
+            else {
+               mark_ = buf_.size()-1;   // at the '<' of the close
+               state_ = close;
+            }
+            break;
+         }
+         }
+      }
+   }
+
+   /**
+      The close is complete: emits the match unless there is no '>' before the text.
+   */
+   template <typename Emit>
+   bool matched(Emit& emit)
+   {
+      const char* b = buf_.data();
+      const char* gt = scan::find_last(b+quote_+1,b+mark_,'>');
+      if(!gt)
+         return false;
+      emit(std::string_view{b+scan::open.size(),quote_-scan::open.size()},std::string_view{gt+1,std::size_t(b+mark_-gt-1)});
+      buf_.clear();
+      state_ = seek;
+      mark_ = 0;
+      return true;
+   }
+
+   /**
+      The candidate in 'buf_' does not match: what follows its '<' is scanned again.
+   */
+   void fail()
+   {
+      replay_.assign(buf_,1);
+      buf_.clear();
+      state_ = seek;
+      mark_ = 0;
+   }
+
+   const std::size_t max_tag_;
+   state_t           state_{seek};
+   std::string       buf_;           // the candidate tag so far
+   std::size_t       mark_{0};       // where the literal being matched starts in 'buf_', then the '<' of the close
+   std::size_t       quote_{0};      // of the end of the href in 'buf_'
+   std::string       replay_;        // to be scanned before the rest of the input
+};
+
+}  // end of namespace stream
+
+#endif // REGEX_STREAM_H_
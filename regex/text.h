@@ -0,0 +1,194 @@
+#ifndef REGEX_TEXT_H_
+#define REGEX_TEXT_H_
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <string>
+#include <string_view>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+/**
+   Clean-up of the extracted text before it leaves the program: the UTF-8 is validated and HTML character references are decoded.
+
+   Most link text is plain ASCII without a single '&', there is nothing to do about it and the input is returned as it is
+   after a SIMD check of 16 bytes at a time. Otherwise the same SIMD search skips the runs of such bytes and copies them at once,
+   only a byte '&' or one of 0x80 and above is looked at one by one:
+      - a UTF-8 sequence is checked against the table 3-7 of the Unicode standard (no overlong forms, no surrogates, at most U+10FFFF),
+        an ill-formed one is replaced by U+FFFD per maximal subpart: the bytes which begin a valid sequence but break off
+        before its end become one U+FFFD, any other invalid byte one of its own
+      - '&name;', '&#digits;' and '&#xhex;' are decoded, a reference to an invalid code point gives U+FFFD,
+        an unknown or malformed one is kept as it is
+   The result is valid UTF-8 in any case.
+
+   \see https://www.unicode.org/versions/latest/ch03.pdf
+   \see https://html.spec.whatwg.org/multipage/syntax.html#character-references
+*/
+
+namespace text
+{
+
+/**
+   \retval the first byte in [p,end) which is '&' or not ASCII, 'end' if there is none
+*/
+inline const char* find_special(const char* p, const char* end) noexcept
+{
+#ifdef __SSE2__
+   const auto amp = _mm_set1_epi8('&');
+   for(; end-p>=16; p+=16) {
+      const auto x = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+      const unsigned m = _mm_movemask_epi8(_mm_or_si128(x,_mm_cmpeq_epi8(x,amp)));
+      if(m)
+         return p+__builtin_ctz(m);
+   }
+#endif
+   for(; p!=end; ++p)
+      if('&'==*p || static_cast<unsigned char>(*p)>=0x80)
+         return p;
+   return end;
+}
+
+/**
+   \retval true if there is nothing to validate nor to decode
+*/
+inline bool plain(std::string_view in) noexcept
+{
+   return in.data()+in.size()==find_special(in.data(),in.data()+in.size());
+}
+
+/**
+   \param 'n' is set to the length of the sequence the byte at 'p' begins, 0 if it begins none
+   \retval how many bytes at 'p' agree with a valid UTF-8 sequence, up to 'n' (the maximal subpart if less than 'n')
+*/
+inline std::size_t valid_prefix(const char* p, const char* end, std::size_t& n) noexcept
+{
+   const auto* s = reinterpret_cast<const unsigned char*>(p);
+   const unsigned char c = s[0];
+   n = c<0x80? 1 : c<0xC2? 0 : c<0xE0? 2 : c<0xF0? 3 : c<0xF5? 4 : 0;
+   if(n<2)
+      return n;
+   const unsigned char lo = 0xE0==c? 0xA0 : 0xF0==c? 0x90 : 0x80;
+   const unsigned char hi = 0xED==c? 0x9F : 0xF4==c? 0x8F : 0xBF;
+   if(end-p<2 || s[1]<lo || s[1]>hi)
+      return 1;
+   std::size_t i{2};
+   while(i<n && p+i<end && 0x80==(s[i]&0xC0))
+      ++i;
+   return i;
+}
+
+inline void append_utf8(std::string& out, std::uint32_t cp)
+{
+   if(0==cp || (cp>=0xD800 && cp<=0xDFFF) || cp>0x10FFFF)
+      cp = 0xFFFD;
+   if(cp<0x80)
+      out += char(cp);
+   else if(cp<0x800) {
+      out += char(0xC0|cp>>6);
+      out += char(0x80|(cp&0x3F));
+   }
+   else if(cp<0x10000) {
+      out += char(0xE0|cp>>12);
+      out += char(0x80|(cp>>6&0x3F));
+      out += char(0x80|(cp&0x3F));
+   }
+   else {
+      out += char(0xF0|cp>>18);
+      out += char(0x80|(cp>>12&0x3F));
+      out += char(0x80|(cp>>6&0x3F));
+      out += char(0x80|(cp&0x3F));
+   }
+}
+
+/**
+   Decodes the character reference at 'p' (at its '&') into 'out'.
+   \retval its length, 0 if it is not one
+*/
+inline std::size_t reference(const char* p, const char* end, std::string& out)
+{
+   struct named { std::string_view name; std::uint32_t cp; };
+   static constexpr named names[] = {   // sorted by name
+      {"amp",'&'}, {"apos",'\''}, {"bull",0x2022}, {"copy",0xA9}, {"deg",0xB0}, {"euro",0x20AC}, {"gt",'>'},
+      {"hellip",0x2026}, {"laquo",0xAB}, {"ldquo",0x201C}, {"lsquo",0x2018}, {"lt",'<'}, {"mdash",0x2014}, {"middot",0xB7},
+      {"nbsp",0xA0}, {"ndash",0x2013}, {"quot",'"'}, {"raquo",0xBB}, {"rdquo",0x201D}, {"reg",0xAE}, {"rsquo",0x2019},
+      {"times",0xD7}, {"trade",0x2122},
+   };
+   constexpr std::size_t longest{32};
+
+   const char* limit = std::size_t(end-p)>longest? p+longest : end;
+   const char* semicolon = std::find(p+1,limit,';');
+   if(semicolon==limit)
+      return 0;
+   const std::string_view body{p+1,std::size_t(semicolon-p-1)};
+   if(body.empty())
+      return 0;
+   if('#'==body[0]) {
+      const bool hex = body.size()>1 && ('x'==body[1] || 'X'==body[1]);
+      const auto digits = body.substr(hex? 2 : 1);
+      if(digits.empty())
+         return 0;
+      std::uint32_t cp{0};
+      for(const char c: digits) {
+         unsigned d;
+         if(c>='0' && c<='9')
+            d = c-'0';
+         else if(hex && ((c|0x20)>='a' && (c|0x20)<='f'))
+            d = (c|0x20)-'a'+10;
+         else
+            return 0;
+         cp = std::min<std::uint32_t>(cp*(hex? 16 : 10)+d,0x110000);   // saturated, invalid anyway
+      }
+      append_utf8(out,cp);
+   }
+   else {
+      const auto* it = std::lower_bound(std::begin(names),std::end(names),body,[](const named& n, std::string_view b){ return n.name<b; });
+      if(it==std::end(names) || it->name!=body)
+         return 0;
+      append_utf8(out,it->cp);
+   }
+   return semicolon+1-p;
+}
+
+/**
+   \retval the valid, decoded text: 'in' itself if it is plain, otherwise a view of 'buffer' which it has been written to
+*/
+inline std::string_view clean(std::string_view in, std::string& buffer)
+{
+   const char* p = in.data();
+   const char* const end = p+in.size();
+   const char* special = find_special(p,end);
+   if(end==special)
+      return in;
+
+   buffer.clear();
+   for(;;) {
+      buffer.append(p,special-p);
+      p = special;
+      if(end==p)
+         return buffer;
+      if('&'==*p) {
+         const auto n = reference(p,end,buffer);
+         if(!n)
+            buffer += *p;
+         p += std::max<std::size_t>(n,1);
+      }
+      else {
+         std::size_t n;
+         const auto valid = valid_prefix(p,end,n);
+         if(n && valid==n)
+            buffer.append(p,n);
+         else
+            buffer += "\xEF\xBF\xBD";   // U+FFFD
+         p += std::max<std::size_t>(valid,1);
+      }
+      special = find_special(p,end);
+   }
+}
+
+}  // end of namespace text
+
+#endif // REGEX_TEXT_H_